@@ -0,0 +1,441 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "delta/allocator.h"
+#include "delta/arena.h"
+#include "delta/hash.h"
+#include "delta/perf.h"
+#include "delta/pool.h"
+#include "delta/strmap.h"
+#include "delta/strset.h"
+#include "delta/tcache.h"
+#include "delta/tracker.h"
+#include "delta/vec.h"
+
+/* Seed of all the random inputs, so that runs are comparable. */
+#define SEED 42
+
+/* Least number of operations timed by a benchmark: small sizes are repeated
+ * until they reach it. */
+#define MIN_OPS (1 << 20)
+
+/* Length of the strmap keys, 16 hexadecimal digits. */
+#define KEY_LEN 16
+
+/* Largest vec sorted: vec_sort is still quadratic (see the TODO in vec.c). */
+#define SORT_MAX_SIZE 10000
+
+/* Number of live allocations of the allocator churn. */
+#define SLOTS 4096
+
+/* Name prefix of the benchmarks to run, all of them if NULL. */
+static const char* filter = NULL;
+
+/* Sum of results printed at the end, so that nothing is optimized out. */
+static size_t checksum = 0;
+
+/* Hardware counters of the lookups and appends, whose events can't all be
+ * counted everywhere. */
+static perf_t* perf = NULL;
+
+static uint64_t xorshift(uint64_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* Bijective mix of i, so that distinct indices make distinct keys. */
+static uint64_t splitmix(uint64_t i) {
+    uint64_t z = i * 0x9e3779b97f4a7c15ULL + SEED;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static int enabled(const char* name) {
+    return filter == NULL || strncmp(name, filter, strlen(filter)) == 0;
+}
+
+/* Adds the counts of the region measured by perf to sum, and zeroes them. */
+static void count_region(perf_counts_t* sum) {
+    const perf_counts_t counts = perf_read(perf);
+    for (size_t i = 0; i < PERF_NB_EVENTS; ++i) {
+        sum->counts[i] += counts.counts[i];
+        sum->counted[i] = counts.counted[i];
+    }
+    perf_reset(perf);
+}
+
+/* Prints a result as a JSON object: its time per operation, the peak number
+ * of bytes allocated by the benchmarked structure, and the events per
+ * operation which were counted if counts isn't NULL. */
+static void report(const char* name, size_t size, size_t ops, double seconds,
+                   size_t bytes, const perf_counts_t* counts) {
+    static int first = 1;
+    printf("%s\n    {\"name\": \"%s\", \"size\": %zu, \"ops\": %zu, "
+           "\"ns_per_op\": %.2f, \"bytes\": %zu",
+           first ? "" : ",", name, size, ops, seconds * 1e9 / (double)ops,
+           bytes);
+    for (size_t i = 0; counts != NULL && i < PERF_NB_EVENTS; ++i) {
+        if (counts->counted[i]) {
+            printf(", \"%s_per_op\": %.3f", perf_event_name((perf_event_t)i),
+                   (double)counts->counts[i] / (double)ops);
+        }
+    }
+    printf("}");
+    first = 0;
+    fflush(stdout);
+}
+
+/*********************************** strmap **********************************/
+
+/* Returns n keys of KEY_LEN characters, NUL-terminated, KEY_LEN + 1 bytes
+ * apart. The keys from index n on are the ones of missing lookups. */
+static char* make_keys(size_t from, size_t n) {
+    char* keys = malloc(n * (KEY_LEN + 1));
+    for (size_t i = 0; keys != NULL && i < n; ++i) {
+        snprintf(keys + i * (KEY_LEN + 1), KEY_LEN + 1, "%016llx",
+                 (unsigned long long)splitmix(from + i));
+    }
+    return keys;
+}
+
+static void bench_strmap(size_t n) {
+    char* keys = make_keys(0, n);
+    char* missing = make_keys(n, n);
+    size_t* order = malloc(n * sizeof(size_t));
+    tracker_t* tracker = tracker_make(&default_allocator);
+    if (keys == NULL || missing == NULL || order == NULL || tracker == NULL) {
+        fprintf(stderr, "error: out of memory for %zu keys\n", n);
+        exit(1);
+    }
+    /* random order of the keys, for erasures */
+    uint64_t seed = SEED;
+    for (size_t i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    for (size_t i = n; i > 1; --i) {
+        const size_t j = xorshift(&seed) % i;
+        const size_t t = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = t;
+    }
+
+    strmap_config_t config = strmap_config(sizeof(size_t), 0);
+    config.allocator = tracker_allocator(tracker);
+    const size_t rounds = n < MIN_OPS ? MIN_OPS / n : 1;
+    double insert = 0, hit = 0, miss = 0, iterate = 0, erase = 0;
+    perf_counts_t hit_counts = {{0}, {0}}, miss_counts = {{0}, {0}};
+    size_t bytes = 0;
+    for (size_t r = 0; r < rounds; ++r) {
+        strmap_t m = strmap_make_from_config(&config);
+        double start = now();
+        for (size_t i = 0; i < n && m != NULL; ++i) {
+            m = strmap_addv_withlen(m, keys + i * (KEY_LEN + 1), KEY_LEN, i);
+        }
+        insert += now() - start;
+        if (m == NULL) {
+            fprintf(stderr, "error: out of memory for %zu keys\n", n);
+            exit(1);
+        }
+        bytes = tracker_snapshot(tracker, NULL).live_bytes;
+
+        perf_start(perf);
+        start = now();
+        for (size_t i = 0; i < n; ++i) {
+            const size_t k = xorshift(&seed) % n;
+            checksum += *(size_t*)strmap_at_withlen(
+                m, keys + k * (KEY_LEN + 1), KEY_LEN);
+        }
+        hit += now() - start;
+        perf_stop(perf);
+        count_region(&hit_counts);
+
+        perf_start(perf);
+        start = now();
+        for (size_t i = 0; i < n; ++i) {
+            const size_t k = xorshift(&seed) % n;
+            checksum += strmap_at_withlen(m, missing + k * (KEY_LEN + 1),
+                                          KEY_LEN) == NULL;
+        }
+        miss += now() - start;
+        perf_stop(perf);
+        count_region(&miss_counts);
+
+        start = now();
+        for (strmap_iterator_t it = strmap_iterator(m); strmap_next(&it);) {
+            checksum += *(size_t*)it.val_ptr;
+        }
+        iterate += now() - start;
+
+        start = now();
+        for (size_t i = 0; i < n; ++i) {
+            checksum += (size_t)strmap_erase_withlen(
+                m, keys + order[i] * (KEY_LEN + 1), KEY_LEN);
+        }
+        erase += now() - start;
+        strmap_del(m);
+    }
+
+    const size_t ops = rounds * n;
+    report("strmap_insert", n, ops, insert, bytes, NULL);
+    report("strmap_hit", n, ops, hit, bytes, &hit_counts);
+    report("strmap_miss", n, ops, miss, bytes, &miss_counts);
+    report("strmap_iterate", n, ops, iterate, bytes, NULL);
+    report("strmap_erase", n, ops, erase, bytes, NULL);
+
+    tracker_del(tracker);
+    free(order);
+    free(missing);
+    free(keys);
+}
+
+/*********************************** strset **********************************/
+
+static void bench_strset(size_t n) {
+    char* keys = make_keys(0, n);
+    tracker_t* tracker = tracker_make(&default_allocator);
+    if (keys == NULL || tracker == NULL) {
+        fprintf(stderr, "error: out of memory for %zu keys\n", n);
+        exit(1);
+    }
+
+    const size_t rounds = n < MIN_OPS ? MIN_OPS / n : 1;
+    uint64_t seed = SEED;
+    double intern = 0, find = 0, str = 0;
+    size_t bytes = 0;
+    for (size_t r = 0; r < rounds; ++r) {
+        strset_t* set = strset_make_alloc(0, tracker_allocator(tracker));
+        double start = now();
+        for (size_t i = 0; i < n && set != NULL; ++i) {
+            if (strset_intern_withlen(set, keys + i * (KEY_LEN + 1),
+                                      KEY_LEN) == STRSET_NONE) {
+                strset_del(set);
+                set = NULL;
+            }
+        }
+        intern += now() - start;
+        if (set == NULL) {
+            fprintf(stderr, "error: out of memory for %zu keys\n", n);
+            exit(1);
+        }
+        bytes = tracker_snapshot(tracker, NULL).live_bytes;
+
+        start = now();
+        for (size_t i = 0; i < n; ++i) {
+            const size_t k = xorshift(&seed) % n;
+            checksum += strset_find_withlen(set, keys + k * (KEY_LEN + 1),
+                                            KEY_LEN);
+        }
+        find += now() - start;
+
+        start = now();
+        for (size_t i = 0; i < n; ++i) {
+            const uint32_t id = (uint32_t)(xorshift(&seed) % n);
+            checksum += (size_t)strset_str(set, id)[0];
+        }
+        str += now() - start;
+        strset_del(set);
+    }
+
+    const size_t ops = rounds * n;
+    report("strset_intern", n, ops, intern, bytes, NULL);
+    report("strset_find", n, ops, find, bytes, NULL);
+    report("strset_str", n, ops, str, bytes, NULL);
+
+    tracker_del(tracker);
+    free(keys);
+}
+
+/************************************* vec ***********************************/
+
+static bool u64_less(void* vec, size_t i, size_t j) {
+    const uint64_t* v = vec;
+    return v[i] < v[j];
+}
+
+static void bench_vec(size_t n) {
+    tracker_t* tracker = tracker_make(&default_allocator);
+    const allocator_t* allocator = tracker_allocator(tracker);
+    const size_t rounds = n < MIN_OPS ? MIN_OPS / n : 1;
+    uint64_t seed = SEED;
+    double append = 0, sort = 0;
+    perf_counts_t append_counts = {{0}, {0}};
+    size_t bytes = 0;
+    for (size_t r = 0; r < rounds; ++r) {
+        uint64_t* v = vec_make_alloc(uint64_t, 0, 0, allocator);
+        perf_start(perf);
+        double start = now();
+        for (size_t i = 0; i < n; ++i) {
+            vec_append(&v, xorshift(&seed));
+        }
+        append += now() - start;
+        perf_stop(perf);
+        count_region(&append_counts);
+        if (v == NULL || !vec_valid(v)) {
+            fprintf(stderr, "error: out of memory for %zu values\n", n);
+            exit(1);
+        }
+        bytes = tracker_snapshot(tracker, NULL).live_bytes;
+
+        if (r == 0 && n <= SORT_MAX_SIZE) {
+            /* a single sort, as it is slow enough to be timed */
+            start = now();
+            vec_sort(v, u64_less);
+            sort += now() - start;
+        }
+        checksum += (size_t)v[n / 2];
+        vec_del(v);
+    }
+
+    report("vec_append", n, rounds * n, append, bytes, &append_counts);
+    if (n <= SORT_MAX_SIZE) {
+        report("vec_sort", n, n, sort, bytes, NULL);
+    }
+    tracker_del(tracker);
+}
+
+/************************************ hash ***********************************/
+
+static void bench_hash(void) {
+    static const size_t lens[] = {4, 8, 16, 32, 64, 256, 1024, 4096};
+    const size_t total = (size_t)1 << 28;
+    char* buf = malloc(4096 + 64);
+    uint64_t seed = SEED;
+    for (size_t i = 0; i < 4096 + 64; ++i) {
+        buf[i] = (char)xorshift(&seed);
+    }
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); ++l) {
+        const size_t len = lens[l];
+        const size_t ops = total / len < MIN_OPS ? MIN_OPS : total / len;
+        const double start = now();
+        for (size_t i = 0; i < ops; ++i) {
+            /* vary the alignment and content of the keys */
+            checksum += hash_bytes(buf + (i & 63), len, SEED);
+        }
+        report("hash_bytes", len, ops, now() - start, 0, NULL);
+    }
+    free(buf);
+}
+
+/********************************* allocators ********************************/
+
+/* Frees and reallocates random slots, of random sizes mostly small like
+ * container headers and buckets, or of object_size bytes if it isn't 0. The
+ * arena, which doesn't free, is reset every SLOTS allocations instead. */
+static void churn(const char* name, const allocator_t* allocator,
+                  size_t object_size, arena_t* arena) {
+    void* slots[SLOTS] = {NULL};
+    size_t sizes[SLOTS] = {0};
+    const size_t ops = (size_t)16 * MIN_OPS;
+    uint64_t seed = SEED;
+    size_t live = 0, peak = 0;
+
+    const double start = now();
+    for (size_t i = 0; i < ops; ++i) {
+        const size_t s = xorshift(&seed) % SLOTS;
+        const uint64_t r = xorshift(&seed);
+        size_t size = object_size;
+        if (size == 0) {
+            size = (r & 3) != 0 ? 8 + (r >> 8) % 120 : 8 + (r >> 8) % 2040;
+        }
+        if (arena != NULL && i % SLOTS == 0) {
+            arena_reset(arena);
+            live = 0;
+        } else if (arena == NULL) {
+            allocator_dealloc_sized(allocator, slots[s], sizes[s]);
+            live -= sizes[s];
+        }
+        slots[s] = allocator_alloc(allocator, size);
+        sizes[s] = size;
+        *(char*)slots[s] = (char)i;
+        live += size;
+        peak = live > peak ? live : peak;
+    }
+    const double elapsed = now() - start;
+    for (size_t s = 0; arena == NULL && s < SLOTS; ++s) {
+        allocator_dealloc_sized(allocator, slots[s], sizes[s]);
+    }
+    report(name, SLOTS, ops, elapsed, peak, NULL);
+}
+
+static void bench_allocators(void) {
+    churn("alloc_churn_malloc", &default_allocator, 0, NULL);
+
+    tcache_t* tcache = tcache_make();
+    churn("alloc_churn_tcache", tcache_allocator(tcache), 0, NULL);
+    tcache_del(tcache);
+
+    pool_t* pool = pool_make(64);
+    churn("alloc_churn_pool", pool_allocator(pool), 64, NULL);
+    pool_del(pool);
+
+    arena_t* arena = arena_make(0);
+    churn("alloc_churn_arena", arena_allocator(arena), 0, arena);
+    arena_del(arena);
+}
+
+/*
+ * This program times the hot paths of the library with fixed seeds, and
+ * prints the results as JSON so that they can be compared between revisions:
+ * strmap insertions, hit and missing lookups, iteration and erasures, vec
+ * appends, and strset interning and lookups of strings and of ids, for sizes
+ * from 1K to MAX_SIZE by factors of 10, vec sorts up to SORT_MAX_SIZE values,
+ * hash throughput by key length and allocator churn.
+ * Lookups and appends also report their hardware events per operation, such
+ * as cycles and cache misses, where the counters are permitted.
+ *
+ * It takes MAX_SIZE (default 1M, up to 100M) and the name prefix of the
+ * benchmarks to run, such as strmap, as optional arguments.
+ */
+int main(int argc, char** argv) {
+    size_t max_size = argc > 1 ? (size_t)atoll(argv[1]) : 1000000;
+    if (max_size < 1000 || max_size > 100000000) {
+        fprintf(stderr, "usage: delta_bench [MAX_SIZE [FILTER]]\n"
+                        "MAX_SIZE must be in [1000, 100000000]\n");
+        return 1;
+    }
+    filter = argc > 2 ? argv[2] : NULL;
+    perf = perf_make();
+    if (perf == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        return 1;
+    }
+    if (!perf_available(perf)) {
+        fprintf(stderr, "warning: hardware counters are not permitted\n");
+    }
+
+    printf("{\"seed\": %d, \"min_ops\": %d, \"results\": [", SEED, MIN_OPS);
+    for (size_t n = 1000; n <= max_size; n *= 10) {
+        if (enabled("strmap")) {
+            bench_strmap(n);
+        }
+        if (enabled("strset")) {
+            bench_strset(n);
+        }
+        if (enabled("vec")) {
+            bench_vec(n);
+        }
+    }
+    if (enabled("hash")) {
+        bench_hash();
+    }
+    if (enabled("alloc")) {
+        bench_allocators();
+    }
+    printf("\n]}\n");
+
+    fprintf(stderr, "checksum %zu\n", checksum);
+    perf_del(perf);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "delta/allocator.h"
+#include "delta/hugepage.h"
+#include "delta/strmap.h"
+
+#define KEY_SIZE 24
+
+static uint64_t xorshift(uint64_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/* Fills a map of n keys allocated with the given allocator, then returns the
+ * average time of a lookup of a random key in nanoseconds. */
+static double bench(const allocator_t* allocator, const char* keys, size_t n,
+                    size_t lookups) {
+    strmap_config_t config = strmap_config(sizeof(size_t), n);
+    config.allocator = allocator;
+    strmap_t m = strmap_make_from_config(&config);
+    for (size_t i = 0; i < n; ++i) {
+        m = strmap_addv(m, keys + i * KEY_SIZE, i);
+    }
+
+    uint64_t seed = 42;
+    size_t sum = 0;
+    const double start = now();
+    for (size_t i = 0; i < lookups; ++i) {
+        const size_t k = xorshift(&seed) % n;
+        const char* key = keys + k * KEY_SIZE;
+        sum += *(size_t*)strmap_at_withlen(m, key, strlen(key));
+    }
+    const double elapsed = now() - start;
+
+    strmap_del(m);
+    /* Print the sum to keep the lookups from being optimized out. */
+    fprintf(stderr, "checksum %zu\n", sum);
+    return elapsed * 1e9 / (double)lookups;
+}
+
+/*
+ * This program compares random-access lookups in a large strmap allocated with
+ * default_allocator and with the huge page allocator. It takes the number of
+ * keys (default 4M) and of lookups (default 16M) as optional arguments.
+ */
+int main(int argc, char** argv) {
+    const size_t n = argc > 1 ? (size_t)atoll(argv[1]) : (size_t)1 << 22;
+    const size_t lookups = argc > 2 ? (size_t)atoll(argv[2]) : (size_t)1 << 24;
+
+    char* keys = malloc(n * KEY_SIZE);
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(keys + i * KEY_SIZE, KEY_SIZE, "key%zu", i);
+    }
+
+    hugepage_t* hugepage = hugepage_make(0, &default_allocator);
+    const double base = bench(&default_allocator, keys, n, lookups);
+    const double huge = bench(hugepage_allocator(hugepage), keys, n, lookups);
+    printf("%zu keys, %zu lookups\n", n, lookups);
+    printf("default_allocator %8.1f ns/lookup\n", base);
+    printf("hugepage          %8.1f ns/lookup (%.2fx)\n", huge, base / huge);
+
+    hugepage_del(hugepage);
+    free(keys);
+    return 0;
+}
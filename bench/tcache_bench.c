@@ -0,0 +1,144 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "delta/allocator.h"
+#include "delta/tcache.h"
+
+#define SLOTS 4096
+#define ROUNDS 200
+
+typedef struct worker {
+    const allocator_t* allocator;
+    pthread_barrier_t* barrier;
+    size_t id;
+    size_t nb_threads;
+    /* Pointers allocated by each worker, indexed by worker id. */
+    void* (*slots)[SLOTS];
+    uint64_t seed;
+} worker_t;
+
+static uint64_t xorshift(uint64_t* s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+/* Returns a random allocation size, mostly small like container headers and
+ * buckets. */
+static size_t random_size(uint64_t* seed) {
+    const uint64_t r = xorshift(seed);
+    return (r & 3) != 0 ? 8 + (r >> 8) % 120 : 8 + (r >> 8) % 2040;
+}
+
+/* Local workload: each thread frees and reallocates random slots of its own. */
+static void* local_worker(void* arg) {
+    worker_t* w = arg;
+    void** slots = w->slots[w->id];
+    memset(slots, 0, sizeof(w->slots[0]));
+    pthread_barrier_wait(w->barrier);
+    for (size_t i = 0; i < ROUNDS * SLOTS; ++i) {
+        const size_t s = xorshift(&w->seed) % SLOTS;
+        allocator_dealloc(w->allocator, slots[s]);
+        slots[s] = allocator_alloc(w->allocator, random_size(&w->seed));
+        *(char*)slots[s] = (char)i;
+    }
+    for (size_t s = 0; s < SLOTS; ++s) {
+        allocator_dealloc(w->allocator, slots[s]);
+    }
+    return NULL;
+}
+
+/* Remote workload: each round, every thread allocates its slots and then frees
+ * the slots of its neighbor, so all memory is freed by another thread than
+ * the one which allocated it. */
+static void* remote_worker(void* arg) {
+    worker_t* w = arg;
+    void** slots = w->slots[w->id];
+    void** neighbor = w->slots[(w->id + 1) % w->nb_threads];
+    pthread_barrier_wait(w->barrier);
+    for (size_t r = 0; r < ROUNDS; ++r) {
+        for (size_t s = 0; s < SLOTS; ++s) {
+            slots[s] = allocator_alloc(w->allocator, random_size(&w->seed));
+            *(char*)slots[s] = (char)s;
+        }
+        pthread_barrier_wait(w->barrier);
+        for (size_t s = 0; s < SLOTS; ++s) {
+            allocator_dealloc(w->allocator, neighbor[s]);
+        }
+        pthread_barrier_wait(w->barrier);
+    }
+    return NULL;
+}
+
+/* Runs the workload on nb_threads threads and returns the number of
+ * allocations per second. */
+static double run(const allocator_t* allocator, void* (*workload)(void*),
+                  size_t nb_threads) {
+    pthread_t threads[nb_threads];
+    worker_t workers[nb_threads];
+    pthread_barrier_t barrier;
+    void* (*slots)[SLOTS] = calloc(nb_threads, sizeof(*slots));
+    struct timespec start, end;
+
+    pthread_barrier_init(&barrier, NULL, (unsigned)nb_threads + 1);
+    for (size_t i = 0; i < nb_threads; ++i) {
+        workers[i].allocator = allocator;
+        workers[i].barrier = &barrier;
+        workers[i].id = i;
+        workers[i].nb_threads = nb_threads;
+        workers[i].slots = slots;
+        workers[i].seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+        pthread_create(&threads[i], NULL, workload, &workers[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_barrier_wait(&barrier);
+    if (workload == remote_worker) {
+        for (size_t r = 0; r < 2 * ROUNDS; ++r) {
+            pthread_barrier_wait(&barrier);
+        }
+    }
+    for (size_t i = 0; i < nb_threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pthread_barrier_destroy(&barrier);
+    free(slots);
+
+    const double seconds = (double)(end.tv_sec - start.tv_sec) +
+                           (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double)(nb_threads * ROUNDS * SLOTS) / seconds;
+}
+
+/*
+ * This program compares the thread scaling of the thread-caching allocator
+ * with the one of default_allocator. It takes the maximum number of threads as
+ * optional argument (8 by default) and prints the allocation throughput of
+ * both allocators for power of 2 thread counts.
+ */
+int main(int argc, char** argv) {
+    const size_t max_threads = argc > 1 ? (size_t)atoi(argv[1]) : 8;
+    tcache_t* tcache = tcache_make();
+
+    printf("%-8s %7s %14s %14s %8s\n", "workload", "threads", "malloc Mop/s",
+           "tcache Mop/s", "speedup");
+    for (int remote = 0; remote <= 1; ++remote) {
+        void* (*workload)(void*) = remote ? remote_worker : local_worker;
+        for (size_t n = 1; n <= max_threads; n *= 2) {
+            const double base = run(&default_allocator, workload, n);
+            const double tc = run(tcache_allocator(tcache), workload, n);
+            printf("%-8s %7zu %14.1f %14.1f %7.2fx\n",
+                   remote ? "remote" : "local", n, base / 1e6, tc / 1e6,
+                   tc / base);
+        }
+    }
+
+    tcache_del(tcache);
+    return 0;
+}
@@ -11,10 +11,26 @@ typedef void* (*allocate_f)(void* /* user-defined context */,
 typedef void (*deallocate_f)(void* /* user-defined context */,
                              void* /* pointer */);
 
+// Resizes the allocation of old_size bytes at pointer to new_size bytes,
+// moving it if needed, and returns its new address. The first
+// min(old_size, new_size) bytes are preserved. NULL is returned in case of
+// error, in which case the allocation is left untouched.
+typedef void* (*reallocate_f)(void* /* user-defined context */,
+                              void* /* pointer */, size_t /* old size */,
+                              size_t /* new size */);
+
+// Frees the allocation at pointer, whose size is given back to the allocator.
+typedef void (*deallocate_sized_f)(void* /* user-defined context */,
+                                   void* /* pointer */, size_t /* size */);
+
+// reallocate and deallocate_sized are optional and may be NULL, in which case
+// the helpers below fall back to allocate and deallocate.
 struct allocator_t {
     void* ctx;
     allocate_f allocate;
     deallocate_f deallocate;
+    reallocate_f reallocate;
+    deallocate_sized_f deallocate_sized;
 };
 
 extern const allocator_t default_allocator;
@@ -23,4 +39,16 @@ void* allocator_alloc(const allocator_t* allocator, size_t size);
 
 void allocator_dealloc(const allocator_t* allocator, void* ptr);
 
+// Resizes an allocation of old_size bytes to new_size bytes, in place if the
+// allocator can, and returns its new address. If ptr is NULL, new_size bytes
+// are allocated.
+// NULL is returned in case of error, in which case ptr is left untouched.
+void* allocator_realloc(const allocator_t* allocator, void* ptr,
+                        size_t old_size, size_t new_size);
+
+// Frees an allocation of size bytes, size being the last size it was
+// allocated or reallocated with.
+void allocator_dealloc_sized(const allocator_t* allocator, void* ptr,
+                             size_t size);
+
 #endif  // DELTA_ALLOCATOR_H_
@@ -0,0 +1,55 @@
+#ifndef DELTA_ARENA_H_
+#define DELTA_ARENA_H_
+
+#include <stddef.h>
+
+#include "delta/allocator.h"
+
+// An arena is a bump allocator: it carves allocations out of large blocks and
+// frees all of them at once when the arena is reset or deleted. Deallocating
+// only gives the memory back when the pointer is the last allocation of the
+// arena, and is a no-op otherwise. Likewise, reallocating the last allocation
+// extends it in place while its block has room, so a growing vec or strmap key
+// buffer is not copied on every growth.
+//
+// Arenas suit request-scoped workloads creating many short-lived containers:
+//
+//   arena_t* arena = arena_make(0);
+//   int* v = vec_make_alloc(int, 0, 16, arena_allocator(arena));
+//   strmap_config_t config = strmap_config(sizeof(int), 0);
+//   config.allocator = arena_allocator(arena);
+//   strmap_t m = strmap_make_from_config(&config);
+//   ...
+//   arena_reset(arena);  // v and m are freed, don't delete them.
+//
+// An arena is not thread-safe.
+typedef struct arena arena_t;
+
+// Returns a new arena allocating blocks of block_size bytes, or of a default
+// size of 64 KiB if block_size is 0. Allocations larger than a quarter of a
+// block get their own block.
+// NULL is returned in case of error.
+arena_t* arena_make(size_t block_size);
+
+// Returns a new arena as arena_make, but use the provided allocator to allocate
+// the blocks.
+// NULL is returned in case of error.
+arena_t* arena_make_alloc(size_t block_size, const allocator_t* allocator);
+
+// Deletes the arena. All the memory allocated from the arena is freed.
+// If NULL is given, nothing is deleted and no error is returned.
+void arena_del(arena_t* arena);
+
+// Frees all the memory allocated from the arena at once. The blocks are kept to
+// serve the next allocations, except the ones of large allocations.
+void arena_reset(arena_t* arena);
+
+// Returns the number of bytes allocated from the arena since it was made or
+// reset, alignment padding included.
+size_t arena_used(const arena_t* arena);
+
+// Returns the allocator allocating from the arena. It is valid until the arena
+// is deleted.
+const allocator_t* arena_allocator(arena_t* arena);
+
+#endif  // DELTA_ARENA_H_
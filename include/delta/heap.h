@@ -0,0 +1,89 @@
+#ifndef DELTA_HEAP_H_
+#define DELTA_HEAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "delta/vec.h"
+
+// A heap is a vec whose elements are ordered so that the least element, as
+// defined by a less function, is always stored at index 0. The heap functions
+// only reorder the vector in place, so a heap can be created with vec_make and
+// deleted with vec_del like any other vec.
+//
+// The dheap_* functions implement a d-ary heap where each node has d children,
+// d being at least 2.
+// A d of 4 or 8 keeps the children of a node on the same cache lines and
+// halves the depth of the heap compared to a binary heap, which makes it
+// faster on large heaps. The heap_* macros are the binary (d = 2) variants.
+//
+// The less function has the same signature as the one used by vec_sort_ctx.
+
+// Reorders the vector so that it satisfies the heap property. O(n).
+void dheap_heapify(void* vec, size_t d, vec_less_ctx_f less, void* ctx);
+
+// Restores the heap property after the element at index i was changed. O(log
+// n).
+void dheap_fix(void* vec, size_t d, size_t i, vec_less_ctx_f less, void* ctx);
+
+// Removes the least element of the heap pointed to by vec_ptr. The removed
+// element is left at index vec_len(vec) until the next push, so it can still be
+// read after this call. The heap must not be empty. O(log n).
+void dheap_pop(void* vec_ptr, size_t d, vec_less_ctx_f less, void* ctx);
+
+// Pushes the value on the heap pointed to by vec_ptr. O(log n).
+// If an error occurs, nothing is pushed and the vector is set as invalid.
+#define dheap_push(vec_ptr, d, value, less, ctx)                            \
+    do {                                                                    \
+        vec_append((vec_ptr), (value));                                     \
+        if (vec_valid(*(vec_ptr))) {                                        \
+            dheap_fix(*(vec_ptr), (d), vec_len(*(vec_ptr)) - 1, (less),     \
+                      (ctx));                                               \
+        }                                                                   \
+    } while (0)
+
+// Replaces the least element of the heap by value. This is cheaper than a pop
+// followed by a push, and is the core operation of streaming top-k. The heap
+// must not be empty. O(log n).
+#define dheap_replace_top(vec, d, value, less, ctx) \
+    do {                                            \
+        (vec)[0] = (value);                         \
+        dheap_fix((vec), (d), 0, (less), (ctx));    \
+    } while (0)
+
+// Returns the least element of the heap. The heap must not be empty.
+#define heap_peek(vec) ((vec)[0])
+
+#define heap_heapify(vec, less, ctx) dheap_heapify((vec), 2, (less), (ctx))
+#define heap_fix(vec, i, less, ctx) dheap_fix((vec), 2, (i), (less), (ctx))
+#define heap_pop(vec_ptr, less, ctx) dheap_pop((vec_ptr), 2, (less), (ctx))
+#define heap_push(vec_ptr, value, less, ctx) \
+    dheap_push((vec_ptr), 2, (value), (less), (ctx))
+#define heap_replace_top(vec, value, less, ctx) \
+    dheap_replace_top((vec), 2, (value), (less), (ctx))
+
+// Min-heaps of primitive keys. They compare the keys directly instead of
+// calling a less function and move elements without vec_swap, which makes
+// them several times faster than the generic heap for numeric keys.
+//
+// heap_push_* pushes the value on the heap pointed to by vec_ptr. If an error
+// occurs, nothing is pushed and the vector is set as invalid.
+// heap_pop_* removes and returns the least element. The heap must not be
+// empty.
+// heap_replace_top_* replaces the least element by value and returns the
+// replaced element. The heap must not be empty.
+#define DELTA_HEAP_TYPED_DECL(suffix, T)                    \
+    void heap_heapify_##suffix(T* vec);                     \
+    void heap_push_##suffix(T** vec_ptr, T value);          \
+    T heap_pop_##suffix(T** vec_ptr);                       \
+    T heap_replace_top_##suffix(T* vec, T value);
+
+DELTA_HEAP_TYPED_DECL(i32, int32_t)
+DELTA_HEAP_TYPED_DECL(u32, uint32_t)
+DELTA_HEAP_TYPED_DECL(i64, int64_t)
+DELTA_HEAP_TYPED_DECL(u64, uint64_t)
+DELTA_HEAP_TYPED_DECL(f64, double)
+
+#undef DELTA_HEAP_TYPED_DECL
+
+#endif  // DELTA_HEAP_H_
@@ -0,0 +1,41 @@
+#ifndef DELTA_HUGEPAGE_H_
+#define DELTA_HUGEPAGE_H_
+
+#include <stddef.h>
+
+#include "delta/allocator.h"
+
+// A Linux allocator backing large allocations with huge pages, to reduce the
+// TLB misses of random accesses to large tables such as the bucket array of a
+// big strmap or a multi-GB vec.
+//
+// Allocations of at least threshold bytes are served by mmap on 2 MiB aligned
+// addresses and advised to use transparent huge pages (MADV_HUGEPAGE). If
+// transparent huge pages are disabled, they are mapped from the reserved
+// hugetlbfs pages (MAP_HUGETLB) when some are configured, and from regular
+// pages otherwise. Smaller allocations are forwarded to a fallback allocator.
+// Reallocating a huge page allocation remaps its pages with mremap, so a large
+// vec grows without being copied.
+//
+// The allocator is thread-safe if the fallback allocator is.
+typedef struct hugepage hugepage_t;
+
+// Size of the huge pages.
+#define HUGEPAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+// Returns a new huge page allocator serving allocations of at least threshold
+// bytes, or of at least HUGEPAGE_SIZE bytes if threshold is 0, and forwarding
+// the smaller ones to the fallback allocator.
+// NULL is returned in case of error.
+hugepage_t* hugepage_make(size_t threshold, const allocator_t* fallback);
+
+// Deletes the allocator. The huge page allocations which weren't freed are
+// unmapped.
+// If NULL is given, nothing is deleted and no error is returned.
+void hugepage_del(hugepage_t* hugepage);
+
+// Returns the allocator allocating huge pages. It is valid until the huge page
+// allocator is deleted.
+const allocator_t* hugepage_allocator(hugepage_t* hugepage);
+
+#endif  // DELTA_HUGEPAGE_H_
@@ -0,0 +1,85 @@
+#ifndef DELTA_PERF_H_
+#define DELTA_PERF_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Hardware performance counters of the calling thread, read with Linux
+// perf_event_open, to tell whether a change cut the cache misses of a region
+// of code or only moved them:
+//
+//   perf_t* perf = perf_make();
+//   perf_start(perf);
+//   ... region ...
+//   perf_stop(perf);
+//   perf_counts_t counts = perf_read(perf);
+//   perf_report(&counts, ops, stderr);
+//
+// The events are counted in user space only, by the calling thread and the
+// threads it creates after perf_make, whose counts are added once they exit.
+//
+// An event which can't be counted, because the kernel doesn't allow it
+// (perf_event_paranoid), the processor has no such counter, or the system
+// isn't Linux, is reported as not counted instead of failing: a region can
+// always be measured, with as many events as are available.
+typedef struct perf perf_t;
+
+// Events counted.
+typedef enum perf_event {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    // Level 1 data cache read misses.
+    PERF_L1D_MISSES,
+    // Last level cache misses.
+    PERF_LLC_MISSES,
+    // Data TLB read misses.
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_NB_EVENTS,
+} perf_event_t;
+
+// Counts of the events.
+typedef struct perf_counts {
+    // Number of events. When there are more events than hardware counters,
+    // the kernel counts them in turns and the counts are scaled to the whole
+    // time counted.
+    uint64_t counts[PERF_NB_EVENTS];
+    // Whether each event was counted.
+    bool counted[PERF_NB_EVENTS];
+} perf_counts_t;
+
+// Returns new counters of the events, stopped and zeroed.
+// NULL is returned in case of error. Events which can't be counted don't make
+// it fail.
+perf_t* perf_make(void);
+
+// Deletes the counters.
+// If NULL is given, nothing is deleted and no error is returned.
+void perf_del(perf_t* perf);
+
+// Returns whether at least one event can be counted.
+bool perf_available(const perf_t* perf);
+
+// Starts counting. The counts add up over the regions between perf_start and
+// perf_stop until perf_reset.
+void perf_start(perf_t* perf);
+
+// Stops counting.
+void perf_stop(perf_t* perf);
+
+// Zeroes the counts.
+void perf_reset(perf_t* perf);
+
+// Returns the counts of the events since the counters were made or reset.
+perf_counts_t perf_read(perf_t* perf);
+
+// Returns the name of the event, such as "cycles" or "l1d_misses".
+const char* perf_event_name(perf_event_t event);
+
+// Prints the count of each event counted, and its count per operation if ops
+// isn't 0, to the provided file.
+void perf_report(const perf_counts_t* counts, size_t ops, FILE* f);
+
+#endif  // DELTA_PERF_H_
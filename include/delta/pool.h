@@ -0,0 +1,44 @@
+#ifndef DELTA_POOL_H_
+#define DELTA_POOL_H_
+
+#include <stddef.h>
+
+#include "delta/allocator.h"
+
+// A pool serves objects of a fixed size from page-sized slabs. Freed objects
+// are kept in an intrusive free list, so allocating and freeing an object are
+// O(1), and objects of the same size stay packed together in memory.
+//
+// Allocations larger than the object size of the pool are forwarded to the
+// allocator the pool was made with. A pool can thus back all the allocations
+// of a container while only its small same-sized objects (vec headers of small
+// vecs, map buckets, ...) are served from the slabs:
+//
+//   pool_t* pool = pool_make(256);
+//   strmap_config_t config = strmap_config(sizeof(size_t), 0);
+//   config.allocator = pool_allocator(pool);
+//   strmap_t m = strmap_make_from_config(&config);
+//
+// A pool is not thread-safe.
+typedef struct pool pool_t;
+
+// Returns a new pool of objects of object_size bytes. Objects are aligned like
+// malloc'd memory.
+// NULL is returned in case of error.
+pool_t* pool_make(size_t object_size);
+
+// Returns a new pool as pool_make, but use the provided allocator to allocate
+// the slabs and the objects larger than object_size.
+// NULL is returned in case of error.
+pool_t* pool_make_alloc(size_t object_size, const allocator_t* allocator);
+
+// Deletes the pool. The slabs are freed, so all the objects allocated from the
+// pool are freed. The larger allocations must have been freed before.
+// If NULL is given, nothing is deleted and no error is returned.
+void pool_del(pool_t* pool);
+
+// Returns the allocator allocating from the pool. It is valid until the pool is
+// deleted.
+const allocator_t* pool_allocator(pool_t* pool);
+
+#endif  // DELTA_POOL_H_
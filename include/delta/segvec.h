@@ -0,0 +1,70 @@
+#ifndef DELTA_SEGVEC_H_
+#define DELTA_SEGVEC_H_
+
+#include <stddef.h>
+
+#include "delta/allocator.h"
+
+// A segmented vector stores its elements in chunks which are never moved nor
+// reallocated, so pointers to elements stay valid until the elements are
+// removed. Chunks grow geometrically from first_chunk_len to max_chunk_len
+// elements and are indexed through a chunk directory, so indexing is O(1) and
+// growing never copies elements.
+//
+// Elements are appended at the back and can be removed from the front, which
+// releases the chunks that no longer hold any element. Indices are stable: an
+// element keeps the index it was appended at, so the valid indices of a
+// segmented vector are in the range [segvec_begin; segvec_end[.
+typedef void* segvec_t;
+
+// Configuration of a segmented vector.
+typedef struct segvec_config {
+    // Size of the element type.
+    size_t value_size;
+    // Number of elements of the first chunk, rounded up to a power of 2.
+    size_t first_chunk_len;
+    // Maximum number of elements of a chunk, rounded up to a power of 2.
+    size_t max_chunk_len;
+    // Allocator of the chunks and of the chunk directory.
+    const allocator_t* allocator;
+} segvec_config_t;
+
+// Returns the default configuration of a segmented vector: the first chunk
+// holds 8 elements and chunks stop growing at 1 MiB.
+segvec_config_t segvec_config(size_t value_size);
+
+// Returns a new segmented vector configured according to the provided
+// configuration. NULL is returned in case of error.
+segvec_t segvec_make_from_config(const segvec_config_t* config);
+
+// Returns a new segmented vector with the default configuration.
+// NULL is returned in case of error.
+segvec_t segvec_make(size_t value_size);
+
+// Deletes the segmented vector. The underlying memory is freed.
+// If NULL is given, nothing is deleted and no error is returned.
+void segvec_del(segvec_t sv);
+
+// Returns the number of elements the segmented vector holds.
+size_t segvec_len(const segvec_t sv);
+
+// Returns the index of the first element.
+size_t segvec_begin(const segvec_t sv);
+
+// Returns the index following the last element.
+size_t segvec_end(const segvec_t sv);
+
+// Returns a pointer to the element stored at index i, which must be in the
+// range [segvec_begin; segvec_end[.
+void* segvec_at(const segvec_t sv, size_t i);
+
+// Appends a copy of the value pointed to by val_ptr and returns a pointer to
+// the stored element. NULL is returned in case of error, in which case nothing
+// is appended.
+void* segvec_append(segvec_t sv, const void* val_ptr);
+
+// Removes the n first elements, or all the elements if there are less than n.
+// The chunks which don't hold any element anymore are freed.
+void segvec_pop_front(segvec_t sv, size_t n);
+
+#endif  // DELTA_SEGVEC_H_
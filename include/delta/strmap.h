@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <string.h>
 
+#include "delta/allocator.h"
+
 typedef void* strmap_t;
 
 /*
@@ -14,10 +16,9 @@ typedef struct strmap_config {
     size_t value_size;
     /* Initial capacity of the map. */
     size_t capacity;
-    /* Allocator function (the default config uses malloc). */
-    void* (*malloc_func)(size_t);
-    /* Re-allocator function (the default config uses realloc). */
-    void* (*realloc_func)(void*, size_t);
+    /* Allocator of the map memory (the default config uses
+     * default_allocator). */
+    const allocator_t* allocator;
     /* String comparison function (the default config uses strncmp). */
     int (*strncmp_func)(const char*, const char*, size_t);
 } strmap_config_t;
@@ -75,7 +76,8 @@ void* strmap_at_withlen(const strmap_t m, const char* key, size_t key_len);
  * Removes the given key and its associated value from the map.
  * Returns whether the key was removed or not.
  */
-int strmap_erase(strmap_t map, const char* key);
+int strmap_erase_withlen(strmap_t map, const char* key, size_t key_len);
+#define strmap_erase(map, key) strmap_erase_withlen((map), (key), strlen(key))
 
 /*
  * Stores the given key and the associated value pointed to by val_ptr in the
@@ -83,14 +85,24 @@ int strmap_erase(strmap_t map, const char* key);
  *
  * Use this function to map strings to structured values.
  *
- * The map is reallocated if it has not enough capacity to hold the new value.
+ * The key is key_len bytes long and doesn't need to be NUL-terminated: it is
+ * copied in the map, which stores it NUL-terminated. strmap_addp takes a
+ * NUL-terminated key.
+ *
+ * The map is reallocated if it has not enough capacity to hold the new value,
+ * or to drop the erased keys once they fill most of its keys buffer. In both
+ * cases every value moves, which invalidates the pointers returned by
+ * strmap_at.
  *
  * The input map may be invalidated. Do not attempt to use it after calling this
  * function.
  *
  * NULL is returned in case of error.
  */
-strmap_t strmap_addp(strmap_t map, const char* key, const void* val_ptr);
+strmap_t strmap_addp_withlen(strmap_t map, const char* key, size_t key_len,
+                             const void* val_ptr);
+#define strmap_addp(map, key, val_ptr) \
+    strmap_addp_withlen((map), (key), strlen(key), (val_ptr))
 
 /*
  * Stores the given key and the associated value in the map.
@@ -100,14 +112,23 @@ strmap_t strmap_addp(strmap_t map, const char* key, const void* val_ptr);
  *
  * Use this function to map strings to literal values like integers or pointers.
  *
- * The map is reallocated if it has not enough capacity to hold the new value.
+ * As with strmap_addp_withlen, the key is key_len bytes long and strmap_addv
+ * takes a NUL-terminated key.
+ *
+ * The map is reallocated if it has not enough capacity to hold the new value,
+ * or to drop the erased keys once they fill most of its keys buffer. In both
+ * cases every value moves, which invalidates the pointers returned by
+ * strmap_at.
  *
  * The input map may be invalidated. Do not attempt to use it after calling this
  * function.
  *
  * NULL is returned in case of error.
  */
-strmap_t strmap_addv(strmap_t map, const char* key, ...);
+strmap_t strmap_addv_withlen(strmap_t map, const char* key, size_t key_len,
+                             ...);
+#define strmap_addv(map, key, ...) \
+    strmap_addv_withlen((map), (key), strlen(key), __VA_ARGS__)
 
 /*
  * An iterator on a map.
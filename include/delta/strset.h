@@ -0,0 +1,73 @@
+#ifndef DELTA_STRSET_H_
+#define DELTA_STRSET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "delta/allocator.h"
+
+// A strset interns strings: each distinct string gets a dense id, 0 for the
+// first one interned, 1 for the next, and so on, and is copied once in an arena
+// where it stays until the set is deleted. The ids are stable, so pipelines can
+// carry them instead of the strings, count them in arrays indexed by id instead
+// of string-keyed maps, and compare them as integers:
+//
+//   strset_t* set = strset_make(0);
+//   size_t* counts = vec_make(size_t, 0, 0);
+//   ...
+//   const uint32_t id = strset_intern_withlen(set, query, query_len);
+//   if (id == vec_len(counts)) {
+//       vec_append(&counts, 0);
+//   }
+//   ++counts[id];
+//   ...
+//   printf("%s %zu\n", strset_str(set, id), counts[id]);
+//
+// Strings are hashed like strmap keys and found in an open addressing table of
+// ids, and the string of an id is found in constant time. Strings may hold NUL
+// characters, and are stored NUL-terminated.
+//
+// A strset is not thread-safe.
+typedef struct strset strset_t;
+
+// Id returned for strings which aren't interned, or in case of error.
+#define STRSET_NONE UINT32_MAX
+
+// Returns a new strset holding at least capacity strings before it grows.
+// NULL is returned in case of error.
+strset_t* strset_make(size_t capacity);
+
+// Returns a new strset as strset_make, but use the provided allocator to
+// allocate the table and the strings.
+// NULL is returned in case of error.
+strset_t* strset_make_alloc(size_t capacity, const allocator_t* allocator);
+
+// Deletes the set. The strings it returned are freed.
+// If NULL is given, nothing is deleted and no error is returned.
+void strset_del(strset_t* set);
+
+// Returns the number of strings interned, which is also the next id.
+size_t strset_len(const strset_t* set);
+
+// Returns the id of the string of len bytes, interning a copy of it first if it
+// isn't interned yet.
+// STRSET_NONE is returned in case of error, in which case the set is left
+// untouched.
+uint32_t strset_intern_withlen(strset_t* set, const char* s, size_t len);
+#define strset_intern(set, s) strset_intern_withlen((set), (s), strlen(s))
+
+// Returns the id of the string of len bytes, or STRSET_NONE if it isn't
+// interned.
+uint32_t strset_find_withlen(const strset_t* set, const char* s, size_t len);
+#define strset_find(set, s) strset_find_withlen((set), (s), strlen(s))
+
+// Returns the NUL-terminated copy of the string of the given id, which must be
+// less than strset_len. It is valid until the set is deleted.
+const char* strset_str(const strset_t* set, uint32_t id);
+
+// Returns the length of the string of the given id, which must be less than
+// strset_len.
+size_t strset_strlen(const strset_t* set, uint32_t id);
+
+#endif  // DELTA_STRSET_H_
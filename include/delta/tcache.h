@@ -0,0 +1,44 @@
+#ifndef DELTA_TCACHE_H_
+#define DELTA_TCACHE_H_
+
+#include <stddef.h>
+
+#include "delta/allocator.h"
+
+// A thread-caching allocator for multi-threaded programs.
+//
+// Allocations are rounded up to a size class. Each thread keeps a cache of free
+// objects per size class and serves its allocations from it without locking.
+// Caches are refilled from, and overflow to, a central heap by batches, so the
+// central heap lock is only taken once per batch. Memory may be freed by
+// another thread than the one which allocated it: the object goes to the cache
+// of the freeing thread, and flows back to the central heap when that cache
+// overflows. Allocations larger than the largest size class are forwarded to
+// the backing allocator.
+//
+// The cache of a thread is returned to the central heap when the thread exits.
+typedef struct tcache tcache_t;
+
+// Returns a new thread-caching allocator backed by default_allocator.
+// NULL is returned in case of error.
+tcache_t* tcache_make(void);
+
+// Returns a new thread-caching allocator as tcache_make, but use the provided
+// allocator, which must be thread-safe, to allocate its memory.
+// NULL is returned in case of error.
+tcache_t* tcache_make_alloc(const allocator_t* allocator);
+
+// Deletes the allocator. All the memory allocated from it is freed, except the
+// allocations forwarded to the backing allocator. No other thread may use the
+// allocator during or after this call.
+// If NULL is given, nothing is deleted and no error is returned.
+void tcache_del(tcache_t* tcache);
+
+// Returns the free objects cached by the calling thread to the central heap.
+void tcache_flush(tcache_t* tcache);
+
+// Returns the allocator allocating from the thread caches. It is valid until
+// the thread-caching allocator is deleted.
+const allocator_t* tcache_allocator(tcache_t* tcache);
+
+#endif  // DELTA_TCACHE_H_
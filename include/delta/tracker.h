@@ -0,0 +1,79 @@
+#ifndef DELTA_TRACKER_H_
+#define DELTA_TRACKER_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "delta/allocator.h"
+
+// A tracker is an allocator forwarding the allocations to another allocator
+// while recording how much memory is allocated, how often, and in which sizes.
+//
+// Allocations can be tagged to attribute them to a call site, a container or a
+// phase of a program: each tag has its own allocator, and the statistics of
+// every tag are recorded separately from the totals.
+//
+//   tracker_t* tracker = tracker_make(&default_allocator);
+//   strmap_config_t config = strmap_config(sizeof(size_t), 0);
+//   config.allocator = tracker_tag(tracker, "queries");
+//   ...
+//   tracker_report(tracker, stderr);
+//
+// The statistics are updated atomically, so a tracker can be used by several
+// threads if the tracked allocator is thread-safe.
+typedef struct tracker tracker_t;
+
+// Number of buckets of the size histogram. Bucket 0 counts allocations of 0 or
+// 1 byte, and bucket i > 0 counts the ones of [2^i; 2^(i+1)[ bytes.
+#define TRACKER_HISTOGRAM_SIZE 40
+
+// Maximum number of tags, including the untagged allocations.
+#define TRACKER_MAX_TAGS 32
+
+// Allocation statistics.
+typedef struct tracker_stats {
+    // Number of bytes currently allocated.
+    size_t live_bytes;
+    // Maximum of live_bytes since the tracker was made or reset.
+    size_t peak_bytes;
+    // Number of allocations and deallocations since the tracker was made or
+    // reset.
+    size_t allocations;
+    size_t deallocations;
+    // Number of allocations by size since the tracker was made or reset.
+    size_t histogram[TRACKER_HISTOGRAM_SIZE];
+} tracker_stats_t;
+
+// Returns a new tracker of the provided allocator.
+// NULL is returned in case of error.
+tracker_t* tracker_make(const allocator_t* allocator);
+
+// Deletes the tracker. All the memory allocated through the tracker must have
+// been freed before.
+// If NULL is given, nothing is deleted and no error is returned.
+void tracker_del(tracker_t* tracker);
+
+// Returns the allocator recording untagged allocations. It is valid until the
+// tracker is deleted.
+const allocator_t* tracker_allocator(tracker_t* tracker);
+
+// Returns the allocator recording the allocations of the given tag, creating
+// the tag if needed. It is valid until the tracker is deleted. Tag names are
+// truncated to 31 characters.
+// NULL is returned if there are already TRACKER_MAX_TAGS tags.
+const allocator_t* tracker_tag(tracker_t* tracker, const char* tag);
+
+// Returns the statistics of all the allocations of the tracker if tag is NULL,
+// or the ones of the given tag. Statistics of an unknown tag are all zeros.
+tracker_stats_t tracker_snapshot(tracker_t* tracker, const char* tag);
+
+// Resets the counters of the tracker and of its tags: the number of
+// allocations and deallocations and the histograms are zeroed, and the peaks
+// are set to the live bytes. Used between the phases of a program, it makes
+// the following snapshots only describe the current phase.
+void tracker_reset(tracker_t* tracker);
+
+// Prints the statistics of the tracker and of each tag to the provided file.
+void tracker_report(tracker_t* tracker, FILE* f);
+
+#endif  // DELTA_TRACKER_H_
@@ -0,0 +1,42 @@
+#ifndef DELTA_VEC_KERNELS_H_
+#define DELTA_VEC_KERNELS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Search and reduction kernels for vecs of primitive values.
+//
+// On x86 the kernels use SSE2 or AVX2 instructions depending on what the CPU
+// supports, which is detected at run time. Other architectures use portable
+// scalar loops.
+
+// Returns the index of the first element of the vector equal to value, or
+// SIZE_MAX if the vector does not contain value.
+size_t vec_find_u8(const uint8_t* vec, uint8_t value);
+size_t vec_find_u32(const uint32_t* vec, uint32_t value);
+size_t vec_find_u64(const uint64_t* vec, uint64_t value);
+
+// Returns the number of elements of the vector equal to value.
+size_t vec_count_eq_u8(const uint8_t* vec, uint8_t value);
+size_t vec_count_eq_u32(const uint32_t* vec, uint32_t value);
+size_t vec_count_eq_u64(const uint64_t* vec, uint64_t value);
+
+// Stores the least and the greatest elements of the vector at the addresses
+// pointed to by min and max. Returns false if the vector is empty, in which
+// case min and max are left untouched. The result of vec_minmax_f64 is
+// unspecified if the vector contains NaNs.
+bool vec_minmax_u8(const uint8_t* vec, uint8_t* min, uint8_t* max);
+bool vec_minmax_u32(const uint32_t* vec, uint32_t* min, uint32_t* max);
+bool vec_minmax_u64(const uint64_t* vec, uint64_t* min, uint64_t* max);
+bool vec_minmax_f64(const double* vec, double* min, double* max);
+
+// Returns the sum of the elements of the vector. vec_sum_u64 wraps around on
+// overflow. vec_sum_f64 adds the elements in an unspecified order, so its
+// result may differ from a sequential sum in the last bits.
+uint64_t vec_sum_u8(const uint8_t* vec);
+uint64_t vec_sum_u32(const uint32_t* vec);
+uint64_t vec_sum_u64(const uint64_t* vec);
+double vec_sum_f64(const double* vec);
+
+#endif  // DELTA_VEC_KERNELS_H_
@@ -0,0 +1,42 @@
+#ifndef DELTA_VEC_MAPPED_H_
+#define DELTA_VEC_MAPPED_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// File-backed vecs.
+//
+// The header and the data of a mapped vec live in a shared memory mapping of a
+// file, so every change made to the vec is written to the file by the kernel,
+// and a vec reopened by another process is available without any
+// deserialization. The file is paged in lazily as the data is accessed.
+//
+// A mapped vec is a regular vec: all the vec functions can be used on it, and
+// vec_del unmaps it. Growing a mapped vec grows the file and its mapping, so
+// like any other vec, pointers into the vec are invalidated by growth.
+//
+// The file format is the in-memory representation of the vec, so it is only
+// readable by a program built for the same architecture and element type.
+
+// Creates the file at path, truncating it if it exists, and returns a new
+// empty vec of T mapped to it, with room for capacity elements.
+// NULL is returned in case of error.
+#define vec_make_mapped(T, path, capacity) \
+    ((T*)vec_make_mapped_impl(sizeof(T), (path), (capacity)))
+
+// Returns the vec of T stored in the file at path.
+// NULL is returned in case of error, or if the file doesn't hold a vec of
+// elements of the size of T.
+#define vec_open_mapped(T, path) \
+    ((T*)vec_open_mapped_impl(sizeof(T), (path)))
+
+void* vec_make_mapped_impl(size_t value_size, const char* path,
+                           size_t capacity);
+
+void* vec_open_mapped_impl(size_t value_size, const char* path);
+
+// Synchronously writes the content of the mapped vec to its file.
+// Returns false in case of error.
+bool vec_sync_mapped(const void* vec);
+
+#endif  // DELTA_VEC_MAPPED_H_
@@ -1,6 +1,7 @@
 #include "delta/allocator.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 static void* default_allocate(void* ctx, size_t n) {
     (void)ctx;
@@ -12,10 +13,19 @@ static void default_deallocate(void* ctx, void* ptr) {
     free(ptr);
 }
 
+static void* default_reallocate(void* ctx, void* ptr, size_t old_size,
+                                size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
 const allocator_t default_allocator = {
     .ctx = NULL,
     .allocate = default_allocate,
     .deallocate = default_deallocate,
+    .reallocate = default_reallocate,
+    .deallocate_sized = NULL,
 };
 
 void* allocator_alloc(const allocator_t* allocator, size_t size) {
@@ -25,3 +35,30 @@ void* allocator_alloc(const allocator_t* allocator, size_t size) {
 void allocator_dealloc(const allocator_t* allocator, void* ptr) {
     allocator->deallocate(allocator->ctx, ptr);
 }
+
+void* allocator_realloc(const allocator_t* allocator, void* ptr,
+                        size_t old_size, size_t new_size) {
+    if (ptr == NULL) {
+        return allocator_alloc(allocator, new_size);
+    }
+    if (allocator->reallocate != NULL) {
+        return allocator->reallocate(allocator->ctx, ptr, old_size, new_size);
+    }
+
+    void* p = allocator_alloc(allocator, new_size);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+    allocator_dealloc_sized(allocator, ptr, old_size);
+    return p;
+}
+
+void allocator_dealloc_sized(const allocator_t* allocator, void* ptr,
+                             size_t size) {
+    if (allocator->deallocate_sized != NULL) {
+        allocator->deallocate_sized(allocator->ctx, ptr, size);
+        return;
+    }
+    allocator->deallocate(allocator->ctx, ptr);
+}
@@ -0,0 +1,185 @@
+#include "delta/arena.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "delta/allocator.h"
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+#define align_up(n) (((n) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+typedef struct arena_block {
+    struct arena_block* next;
+    // Number of bytes that can be allocated from the block.
+    size_t size;
+} arena_block;
+
+#define block_data(b) ((char*)(b) + align_up(sizeof(arena_block)))
+
+struct arena {
+    allocator_t allocator;
+    const allocator_t* block_allocator;
+    size_t block_size;
+
+    // Blocks allocations are carved from. The first one is the current block.
+    arena_block* blocks;
+    // Blocks kept by arena_reset to serve the next allocations.
+    arena_block* spare_blocks;
+    // Blocks of the allocations too large to be carved from a block.
+    arena_block* large_blocks;
+
+    // Number of bytes allocated from the current block.
+    size_t offset;
+    // Last allocation carved from the current block, which can be rolled back.
+    char* last;
+    size_t used;
+};
+
+static arena_block* new_block(arena_t* a, size_t size) {
+    arena_block* b = allocator_alloc(a->block_allocator,
+                                     align_up(sizeof(arena_block)) + size);
+    if (b == NULL) {
+        return NULL;
+    }
+    b->next = NULL;
+    b->size = size;
+    return b;
+}
+
+static void free_blocks(arena_t* a, arena_block* b) {
+    while (b != NULL) {
+        arena_block* next = b->next;
+        allocator_dealloc(a->block_allocator, b);
+        b = next;
+    }
+}
+
+static void* arena_allocate(void* ctx, size_t n) {
+    arena_t* a = ctx;
+    const size_t size = align_up(n);
+
+    if (size > a->block_size / 4) {
+        arena_block* b = new_block(a, size);
+        if (b == NULL) {
+            return NULL;
+        }
+        b->next = a->large_blocks;
+        a->large_blocks = b;
+        a->used += size;
+        return block_data(b);
+    }
+
+    if (a->blocks == NULL || a->offset + size > a->blocks->size) {
+        arena_block* b = a->spare_blocks;
+        if (b != NULL) {
+            a->spare_blocks = b->next;
+        } else if ((b = new_block(a, a->block_size)) == NULL) {
+            return NULL;
+        }
+        b->next = a->blocks;
+        a->blocks = b;
+        a->offset = 0;
+    }
+
+    a->last = block_data(a->blocks) + a->offset;
+    a->offset += size;
+    a->used += size;
+    return a->last;
+}
+
+static void arena_deallocate(void* ctx, void* ptr) {
+    arena_t* a = ctx;
+    if (ptr == NULL || ptr != a->last) {
+        return;
+    }
+    const size_t offset = (size_t)(a->last - block_data(a->blocks));
+    a->used -= a->offset - offset;
+    a->offset = offset;
+    a->last = NULL;
+}
+
+static void* arena_reallocate(void* ctx, void* ptr, size_t old_size,
+                              size_t new_size) {
+    arena_t* a = ctx;
+    const size_t old_aligned = align_up(old_size);
+    const size_t new_aligned = align_up(new_size);
+
+    if (new_aligned <= old_aligned) {
+        return ptr;
+    }
+    // The last allocation is extended in place if the block has room left.
+    if (ptr == a->last) {
+        const size_t offset = (size_t)(a->last - block_data(a->blocks));
+        if (offset + new_aligned <= a->blocks->size) {
+            a->used += offset + new_aligned - a->offset;
+            a->offset = offset + new_aligned;
+            return ptr;
+        }
+    }
+
+    void* p = arena_allocate(a, new_size);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(p, ptr, old_size);
+    return p;
+}
+
+arena_t* arena_make_alloc(size_t block_size, const allocator_t* allocator) {
+    arena_t* a = allocator_alloc(allocator, sizeof(arena_t));
+    if (a == NULL) {
+        return NULL;
+    }
+
+    a->allocator.ctx = a;
+    a->allocator.allocate = arena_allocate;
+    a->allocator.deallocate = arena_deallocate;
+    a->allocator.reallocate = arena_reallocate;
+    a->allocator.deallocate_sized = NULL;
+    a->block_allocator = allocator;
+    a->block_size =
+        align_up(block_size == 0 ? ARENA_DEFAULT_BLOCK_SIZE : block_size);
+    a->blocks = NULL;
+    a->spare_blocks = NULL;
+    a->large_blocks = NULL;
+    a->offset = 0;
+    a->last = NULL;
+    a->used = 0;
+
+    return a;
+}
+
+arena_t* arena_make(size_t block_size) {
+    return arena_make_alloc(block_size, &default_allocator);
+}
+
+void arena_del(arena_t* a) {
+    if (a == NULL) {
+        return;
+    }
+    free_blocks(a, a->blocks);
+    free_blocks(a, a->spare_blocks);
+    free_blocks(a, a->large_blocks);
+    allocator_dealloc(a->block_allocator, a);
+}
+
+void arena_reset(arena_t* a) {
+    while (a->blocks != NULL) {
+        arena_block* b = a->blocks;
+        a->blocks = b->next;
+        b->next = a->spare_blocks;
+        a->spare_blocks = b;
+    }
+    free_blocks(a, a->large_blocks);
+    a->large_blocks = NULL;
+    a->offset = 0;
+    a->last = NULL;
+    a->used = 0;
+}
+
+size_t arena_used(const arena_t* a) { return a->used; }
+
+const allocator_t* arena_allocator(arena_t* a) { return &a->allocator; }
@@ -0,0 +1,144 @@
+#include "delta/heap.h"
+
+#include <assert.h>
+
+#include "delta/vec.h"
+
+// Moves the element at index i up until its parent is not greater than it.
+// Returns whether the element moved.
+static bool dheap_up(void* vec, size_t d, size_t i, vec_less_ctx_f less,
+                     void* ctx) {
+    const size_t start = i;
+    while (i > 0) {
+        const size_t parent = (i - 1) / d;
+        if (less(vec, parent, i, ctx)) {
+            break;
+        }
+        vec_swap(vec, parent, i);
+        i = parent;
+    }
+    return i != start;
+}
+
+// Moves the element at index i down until none of its children is less than
+// it.
+static void dheap_down(void* vec, size_t d, size_t i, size_t len,
+                       vec_less_ctx_f less, void* ctx) {
+    while (1) {
+        const size_t first = i * d + 1;
+        if (first >= len) {
+            return;
+        }
+        const size_t last = first + d < len ? first + d : len;
+        size_t least = first;
+        for (size_t c = first + 1; c < last; ++c) {
+            if (!less(vec, least, c, ctx)) {
+                least = c;
+            }
+        }
+        if (less(vec, i, least, ctx)) {
+            return;
+        }
+        vec_swap(vec, i, least);
+        i = least;
+    }
+}
+
+void dheap_heapify(void* vec, size_t d, vec_less_ctx_f less, void* ctx) {
+    assert(d >= 2);
+    const size_t len = vec_len(vec);
+    if (len < 2) {
+        return;
+    }
+    for (size_t i = (len - 2) / d + 1; i-- > 0;) {
+        dheap_down(vec, d, i, len, less, ctx);
+    }
+}
+
+void dheap_fix(void* vec, size_t d, size_t i, vec_less_ctx_f less, void* ctx) {
+    assert(d >= 2);
+    if (!dheap_up(vec, d, i, less, ctx)) {
+        dheap_down(vec, d, i, vec_len(vec), less, ctx);
+    }
+}
+
+void dheap_pop(void* vec_ptr, size_t d, vec_less_ctx_f less, void* ctx) {
+    assert(d >= 2);
+    void* vec = *(void**)vec_ptr;
+    const size_t n = vec_len(vec) - 1;
+    vec_swap(vec, 0, n);
+    vec_resize(vec_ptr, n);
+    dheap_down(vec, d, 0, n, less, ctx);
+}
+
+// The typed heaps move a hole instead of swapping elements: the moved value is
+// kept in a local and only written once at its final position.
+#define DEFINE_TYPED_HEAP(suffix, T)                                      \
+    static void heap_up_##suffix(T* vec, size_t i) {                      \
+        const T value = vec[i];                                           \
+        while (i > 0) {                                                   \
+            const size_t parent = (i - 1) / 2;                            \
+            if (!(value < vec[parent])) {                                 \
+                break;                                                    \
+            }                                                             \
+            vec[i] = vec[parent];                                         \
+            i = parent;                                                   \
+        }                                                                 \
+        vec[i] = value;                                                   \
+    }                                                                     \
+                                                                          \
+    static void heap_down_##suffix(T* vec, size_t i, size_t len) {        \
+        const T value = vec[i];                                           \
+        while (1) {                                                       \
+            size_t child = i * 2 + 1;                                     \
+            if (child >= len) {                                           \
+                break;                                                    \
+            }                                                             \
+            if (child + 1 < len && vec[child + 1] < vec[child]) {         \
+                ++child;                                                  \
+            }                                                             \
+            if (!(vec[child] < value)) {                                  \
+                break;                                                    \
+            }                                                             \
+            vec[i] = vec[child];                                          \
+            i = child;                                                    \
+        }                                                                 \
+        vec[i] = value;                                                   \
+    }                                                                     \
+                                                                          \
+    void heap_heapify_##suffix(T* vec) {                                  \
+        const size_t len = vec_len(vec);                                  \
+        for (size_t i = len / 2; i-- > 0;) {                              \
+            heap_down_##suffix(vec, i, len);                              \
+        }                                                                 \
+    }                                                                     \
+                                                                          \
+    void heap_push_##suffix(T** vec_ptr, T value) {                       \
+        vec_append(vec_ptr, value);                                       \
+        if (vec_valid(*vec_ptr)) {                                        \
+            heap_up_##suffix(*vec_ptr, vec_len(*vec_ptr) - 1);            \
+        }                                                                 \
+    }                                                                     \
+                                                                          \
+    T heap_pop_##suffix(T** vec_ptr) {                                    \
+        T* vec = *vec_ptr;                                                \
+        const size_t n = vec_len(vec) - 1;                                \
+        const T top = vec[0];                                             \
+        vec[0] = vec[n];                                                  \
+        vec_resize(vec_ptr, n);                                           \
+        heap_down_##suffix(vec, 0, n);                                    \
+        return top;                                                       \
+    }                                                                     \
+                                                                          \
+    T heap_replace_top_##suffix(T* vec, T value) {                        \
+        const T top = vec[0];                                             \
+        vec[0] = value;                                                   \
+        heap_down_##suffix(vec, 0, vec_len(vec));                         \
+        return top;                                                       \
+    }
+
+DEFINE_TYPED_HEAP(i32, int32_t)
+DEFINE_TYPED_HEAP(u32, uint32_t)
+DEFINE_TYPED_HEAP(i64, int64_t)
+DEFINE_TYPED_HEAP(u64, uint64_t)
+DEFINE_TYPED_HEAP(f64, double)
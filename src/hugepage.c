@@ -0,0 +1,254 @@
+#define _GNU_SOURCE
+#include "delta/hugepage.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "delta/allocator.h"
+#include "delta/vec.h"
+
+#define align_up(n, a) (((n) + (a) - 1) & ~((a) - 1))
+
+typedef struct hugepage_mapping {
+    void* ptr;
+    size_t size;
+} hugepage_mapping;
+
+struct hugepage {
+    allocator_t allocator;
+    const allocator_t* fallback;
+    size_t threshold;
+    // Whether transparent huge pages can be requested with madvise.
+    bool thp;
+
+    // Protects mappings.
+    pthread_mutex_t lock;
+    hugepage_mapping* mappings;
+};
+
+// Returns whether transparent huge pages are enabled, in madvise or always
+// mode.
+static bool thp_enabled(void) {
+    char mode[128] = {0};
+    FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f == NULL) {
+        return false;
+    }
+    const bool read = fgets(mode, sizeof(mode), f) != NULL;
+    fclose(f);
+    return read && strstr(mode, "[never]") == NULL;
+}
+
+// Maps size bytes on a HUGEPAGE_SIZE aligned address, by mapping one more huge
+// page and unmapping the unaligned head and tail.
+static void* mmap_aligned(size_t size) {
+    const size_t mapped = size + HUGEPAGE_SIZE;
+    char* p = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    char* aligned = (char*)align_up((uintptr_t)p, HUGEPAGE_SIZE);
+    if (aligned != p) {
+        munmap(p, (size_t)(aligned - p));
+    }
+    munmap(aligned + size, (size_t)(p + mapped - (aligned + size)));
+    return aligned;
+}
+
+// Maps size bytes, which must be a multiple of HUGEPAGE_SIZE, backed by huge
+// pages if possible.
+static void* map_huge(hugepage_t* h, size_t size) {
+    if (h->thp) {
+        void* p = mmap_aligned(size);
+        if (p != NULL && madvise(p, size, MADV_HUGEPAGE) != 0) {
+            // The kernel doesn't support transparent huge pages after all.
+            h->thp = false;
+        }
+        return p;
+    }
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        return p;
+    }
+    // No hugetlbfs page is available.
+    return mmap_aligned(size);
+}
+
+static void* hugepage_allocate(void* ctx, size_t n) {
+    hugepage_t* h = ctx;
+
+    if (n < h->threshold) {
+        return allocator_alloc(h->fallback, n);
+    }
+
+    const size_t size = align_up(n, HUGEPAGE_SIZE);
+    pthread_mutex_lock(&h->lock);
+    void* p = map_huge(h, size);
+    if (p != NULL) {
+        const hugepage_mapping m = {p, size};
+        vec_append(&h->mappings, m);
+        if (!vec_valid(h->mappings)) {
+            munmap(p, size);
+            p = NULL;
+        }
+    }
+    pthread_mutex_unlock(&h->lock);
+    return p;
+}
+
+// Returns the index of the huge page mapping at ptr, or SIZE_MAX if ptr was
+// allocated by the fallback allocator. The lock must be held.
+static size_t find_mapping(const hugepage_t* h, const void* ptr) {
+    const size_t len = vec_len(h->mappings);
+    for (size_t i = 0; i < len; ++i) {
+        if (h->mappings[i].ptr == ptr) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// Unmaps the huge page mapping at ptr and returns whether there was one.
+static bool unmap_huge(hugepage_t* h, void* ptr) {
+    pthread_mutex_lock(&h->lock);
+    const size_t i = find_mapping(h, ptr);
+    if (i != SIZE_MAX) {
+        const size_t len = vec_len(h->mappings);
+        munmap(ptr, h->mappings[i].size);
+        h->mappings[i] = h->mappings[len - 1];
+        vec_resize(&h->mappings, len - 1);
+    }
+    pthread_mutex_unlock(&h->lock);
+    return i != SIZE_MAX;
+}
+
+static void hugepage_deallocate(void* ctx, void* ptr) {
+    hugepage_t* h = ctx;
+
+    // Huge page mappings are aligned, which saves looking up the mappings when
+    // freeing most of the fallback allocations.
+    if (((uintptr_t)ptr & (HUGEPAGE_SIZE - 1)) != 0 || ptr == NULL) {
+        allocator_dealloc(h->fallback, ptr);
+        return;
+    }
+    if (!unmap_huge(h, ptr)) {
+        allocator_dealloc(h->fallback, ptr);
+    }
+}
+
+static void hugepage_deallocate_sized(void* ctx, void* ptr, size_t size) {
+    hugepage_t* h = ctx;
+
+    if (size < h->threshold || ptr == NULL) {
+        allocator_dealloc_sized(h->fallback, ptr, size);
+        return;
+    }
+    unmap_huge(h, ptr);
+}
+
+// Resizes the mapping to size bytes, a multiple of HUGEPAGE_SIZE, without
+// copying it: it is grown in place if the following addresses are free, and
+// its pages are moved to a new aligned mapping otherwise. The lock must be
+// held. NULL is returned in case of error.
+static void* remap_huge(hugepage_t* h, hugepage_mapping* m, size_t size) {
+    if (size < m->size) {
+        munmap((char*)m->ptr + size, m->size - size);
+        m->size = size;
+        return m->ptr;
+    }
+    if (size == m->size) {
+        return m->ptr;
+    }
+
+    void* p = mremap(m->ptr, m->size, size, 0);
+    if (p == MAP_FAILED) {
+        void* q = map_huge(h, size);
+        if (q == NULL) {
+            return NULL;
+        }
+        p = mremap(m->ptr, m->size, size, MREMAP_MAYMOVE | MREMAP_FIXED, q);
+        if (p == MAP_FAILED) {
+            munmap(q, size);
+            return NULL;
+        }
+    }
+    m->ptr = p;
+    m->size = size;
+    return p;
+}
+
+static void* hugepage_reallocate(void* ctx, void* ptr, size_t old_size,
+                                 size_t new_size) {
+    hugepage_t* h = ctx;
+
+    if (old_size < h->threshold && new_size < h->threshold) {
+        return allocator_realloc(h->fallback, ptr, old_size, new_size);
+    }
+    if (old_size >= h->threshold && new_size >= h->threshold) {
+        void* p = NULL;
+        pthread_mutex_lock(&h->lock);
+        const size_t i = find_mapping(h, ptr);
+        if (i != SIZE_MAX) {
+            p = remap_huge(h, &h->mappings[i],
+                           align_up(new_size, HUGEPAGE_SIZE));
+        }
+        pthread_mutex_unlock(&h->lock);
+        if (p != NULL) {
+            return p;
+        }
+    }
+
+    // The allocation moves between the fallback allocator and huge pages, or
+    // the mapping couldn't be remapped.
+    void* p = hugepage_allocate(h, new_size);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+    hugepage_deallocate_sized(h, ptr, old_size);
+    return p;
+}
+
+hugepage_t* hugepage_make(size_t threshold, const allocator_t* fallback) {
+    hugepage_t* h = allocator_alloc(fallback, sizeof(hugepage_t));
+    if (h == NULL) {
+        return NULL;
+    }
+    if ((h->mappings = vec_make_alloc(hugepage_mapping, 0, 16, fallback)) ==
+        NULL) {
+        allocator_dealloc(fallback, h);
+        return NULL;
+    }
+
+    h->allocator.ctx = h;
+    h->allocator.allocate = hugepage_allocate;
+    h->allocator.deallocate = hugepage_deallocate;
+    h->allocator.reallocate = hugepage_reallocate;
+    h->allocator.deallocate_sized = hugepage_deallocate_sized;
+    h->fallback = fallback;
+    h->threshold = threshold == 0 ? HUGEPAGE_SIZE : threshold;
+    h->thp = thp_enabled();
+    pthread_mutex_init(&h->lock, NULL);
+
+    return h;
+}
+
+void hugepage_del(hugepage_t* h) {
+    if (h == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < vec_len(h->mappings); ++i) {
+        munmap(h->mappings[i].ptr, h->mappings[i].size);
+    }
+    vec_del(h->mappings);
+    pthread_mutex_destroy(&h->lock);
+    allocator_dealloc(h->fallback, h);
+}
+
+const allocator_t* hugepage_allocator(hugepage_t* h) { return &h->allocator; }
@@ -0,0 +1,181 @@
+#include "delta/perf.h"
+
+#include <string.h>
+
+#include "delta/allocator.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* event_names[PERF_NB_EVENTS] = {
+    "cycles",     "instructions", "l1d_misses",
+    "llc_misses", "dtlb_misses",  "branch_misses",
+};
+
+struct perf {
+    // File descriptor of the counter of each event, or -1 if it can't be
+    // counted.
+    int fds[PERF_NB_EVENTS];
+};
+
+#ifdef __linux__
+
+// Sets the type and config of attr to the ones counting the event.
+static void event_attr(perf_event_t event, struct perf_event_attr* attr) {
+    static const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr->type = PERF_TYPE_HARDWARE;
+    switch (event) {
+        case PERF_CYCLES:
+            attr->config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_INSTRUCTIONS:
+            attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_L1D_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_L1D | read_miss;
+            break;
+        case PERF_LLC_MISSES:
+            attr->config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PERF_DTLB_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_DTLB | read_miss;
+            break;
+        default:
+            attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+    }
+}
+
+// Opens a disabled counter of the event in user space, for the calling thread
+// and the threads it creates. Returns -1 if the event can't be counted.
+static int open_counter(perf_event_t event) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    event_attr(event, &attr);
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                        PERF_FLAG_FD_CLOEXEC);
+}
+
+static void control(perf_t* perf, unsigned long request) {
+    for (size_t i = 0; i < PERF_NB_EVENTS; ++i) {
+        if (perf->fds[i] >= 0) {
+            ioctl(perf->fds[i], request, 0);
+        }
+    }
+}
+
+void perf_start(perf_t* perf) { control(perf, PERF_EVENT_IOC_ENABLE); }
+
+void perf_stop(perf_t* perf) { control(perf, PERF_EVENT_IOC_DISABLE); }
+
+void perf_reset(perf_t* perf) { control(perf, PERF_EVENT_IOC_RESET); }
+
+perf_counts_t perf_read(perf_t* perf) {
+    perf_counts_t counts;
+    memset(&counts, 0, sizeof(counts));
+    for (size_t i = 0; i < PERF_NB_EVENTS; ++i) {
+        // value, time enabled and time running
+        uint64_t values[3];
+        if (perf->fds[i] < 0 ||
+            read(perf->fds[i], values, sizeof(values)) != sizeof(values)) {
+            continue;
+        }
+        // an event enabled but never scheduled on a counter wasn't counted
+        counts.counted[i] = values[1] == 0 || values[2] != 0;
+        if (values[2] != 0 && values[2] < values[1]) {
+            values[0] = (uint64_t)((double)values[0] * (double)values[1] /
+                                   (double)values[2]);
+        }
+        counts.counts[i] = values[0];
+    }
+    return counts;
+}
+
+#else
+
+static int open_counter(perf_event_t event) {
+    (void)event;
+    return -1;
+}
+
+void perf_start(perf_t* perf) { (void)perf; }
+
+void perf_stop(perf_t* perf) { (void)perf; }
+
+void perf_reset(perf_t* perf) { (void)perf; }
+
+perf_counts_t perf_read(perf_t* perf) {
+    (void)perf;
+    perf_counts_t counts;
+    memset(&counts, 0, sizeof(counts));
+    return counts;
+}
+
+#endif
+
+perf_t* perf_make(void) {
+    perf_t* perf = allocator_alloc(&default_allocator, sizeof(perf_t));
+    if (perf == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < PERF_NB_EVENTS; ++i) {
+        perf->fds[i] = open_counter((perf_event_t)i);
+    }
+    return perf;
+}
+
+void perf_del(perf_t* perf) {
+    if (perf == NULL) {
+        return;
+    }
+#ifdef __linux__
+    for (size_t i = 0; i < PERF_NB_EVENTS; ++i) {
+        if (perf->fds[i] >= 0) {
+            close(perf->fds[i]);
+        }
+    }
+#endif
+    allocator_dealloc(&default_allocator, perf);
+}
+
+bool perf_available(const perf_t* perf) {
+    for (size_t i = 0; i < PERF_NB_EVENTS; ++i) {
+        if (perf->fds[i] >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* perf_event_name(perf_event_t event) {
+    return event < PERF_NB_EVENTS ? event_names[event] : "unknown";
+}
+
+void perf_report(const perf_counts_t* counts, size_t ops, FILE* f) {
+    for (size_t i = 0; i < PERF_NB_EVENTS; ++i) {
+        if (!counts->counted[i]) {
+            fprintf(f, "%-14s not counted\n", event_names[i]);
+        } else if (ops == 0) {
+            fprintf(f, "%-14s %16llu\n", event_names[i],
+                    (unsigned long long)counts->counts[i]);
+        } else {
+            fprintf(f, "%-14s %16llu %12.2f per op\n", event_names[i],
+                    (unsigned long long)counts->counts[i],
+                    (double)counts->counts[i] / (double)ops);
+        }
+    }
+}
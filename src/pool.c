@@ -0,0 +1,252 @@
+#include "delta/pool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "delta/allocator.h"
+
+#define POOL_PAGE_SIZE 4096
+#define POOL_MIN_OBJECTS_PER_SLAB 8
+#define POOL_SLABS_PER_CHUNK 16
+#define POOL_ALIGNMENT _Alignof(max_align_t)
+
+#define align_up(n, a) (((n) + (a) - 1) & ~((a) - 1))
+
+// Slabs are allocated by chunks of POOL_SLABS_PER_CHUNK slabs aligned on the
+// slab size, so that the slab of an object is found by masking its address.
+typedef struct pool_chunk {
+    struct pool_chunk* next;
+} pool_chunk;
+
+// Free objects store the pointer to the next free object.
+typedef struct pool_object {
+    struct pool_object* next;
+} pool_object;
+
+struct pool {
+    allocator_t allocator;
+    const allocator_t* fallback;
+    size_t object_size;
+    size_t slab_size;
+    unsigned slab_shift;
+
+    pool_object* free_list;
+    // Part of the current slab which wasn't handed out yet.
+    char* bump;
+    char* bump_end;
+    // Slabs of the current chunk which weren't used yet.
+    char* next_slab;
+    char* chunk_end;
+    pool_chunk* chunks;
+
+    // Open addressing hash set of the slab numbers (address >> slab_shift)
+    // of the pool, used to tell pool objects from fallback allocations.
+    uintptr_t* slabs;
+    size_t slabs_capacity;
+    size_t nb_slabs;
+};
+
+static size_t slab_hash(const pool_t* p, uintptr_t slab) {
+    return (size_t)((slab * 0x9e3779b97f4a7c15ULL) >> 17) &
+           (p->slabs_capacity - 1);
+}
+
+static int slabs_contain(const pool_t* p, uintptr_t slab) {
+    if (p->nb_slabs == 0) {
+        return 0;
+    }
+    size_t i = slab_hash(p, slab);
+    while (p->slabs[i] != slab) {
+        if (p->slabs[i] == 0) {
+            return 0;
+        }
+        i = (i + 1) & (p->slabs_capacity - 1);
+    }
+    return 1;
+}
+
+static void slabs_insert(pool_t* p, uintptr_t slab) {
+    size_t i = slab_hash(p, slab);
+    while (p->slabs[i] != 0) {
+        i = (i + 1) & (p->slabs_capacity - 1);
+    }
+    p->slabs[i] = slab;
+    ++p->nb_slabs;
+}
+
+// Registers a new slab, growing the hash set to keep its load factor under
+// 1/2. Returns 0 in case of error.
+static int register_slab(pool_t* p, uintptr_t slab) {
+    if (2 * (p->nb_slabs + 1) > p->slabs_capacity) {
+        uintptr_t* old = p->slabs;
+        const size_t old_capacity = p->slabs_capacity;
+        const size_t capacity = old_capacity == 0 ? 64 : old_capacity * 2;
+        uintptr_t* slabs =
+            allocator_alloc(p->fallback, capacity * sizeof(uintptr_t));
+        if (slabs == NULL) {
+            return 0;
+        }
+        memset(slabs, 0, capacity * sizeof(uintptr_t));
+        p->slabs = slabs;
+        p->slabs_capacity = capacity;
+        p->nb_slabs = 0;
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old[i] != 0) {
+                slabs_insert(p, old[i]);
+            }
+        }
+        allocator_dealloc(p->fallback, old);
+    }
+    slabs_insert(p, slab);
+    return 1;
+}
+
+// Makes a new slab the current one. Returns 0 in case of error.
+static int new_slab(pool_t* p) {
+    if (p->next_slab == p->chunk_end) {
+        // One more slab is allocated to align the slabs of the chunk.
+        const size_t size =
+            sizeof(pool_chunk) + (POOL_SLABS_PER_CHUNK + 1) * p->slab_size;
+        pool_chunk* c = allocator_alloc(p->fallback, size);
+        if (c == NULL) {
+            return 0;
+        }
+        c->next = p->chunks;
+        p->chunks = c;
+        p->next_slab = (char*)align_up((uintptr_t)(c + 1), p->slab_size);
+        p->chunk_end = p->next_slab + POOL_SLABS_PER_CHUNK * p->slab_size;
+    }
+
+    if (!register_slab(p, (uintptr_t)p->next_slab >> p->slab_shift)) {
+        return 0;
+    }
+    p->bump = p->next_slab;
+    p->bump_end = p->bump + (p->slab_size / p->object_size) * p->object_size;
+    p->next_slab += p->slab_size;
+    return 1;
+}
+
+static void* pool_allocate(void* ctx, size_t n) {
+    pool_t* p = ctx;
+
+    if (n > p->object_size) {
+        return allocator_alloc(p->fallback, n);
+    }
+    if (p->free_list != NULL) {
+        pool_object* o = p->free_list;
+        p->free_list = o->next;
+        return o;
+    }
+    if (p->bump == p->bump_end && !new_slab(p)) {
+        return NULL;
+    }
+    void* o = p->bump;
+    p->bump += p->object_size;
+    return o;
+}
+
+static void pool_deallocate(void* ctx, void* ptr) {
+    pool_t* p = ctx;
+
+    if (ptr == NULL) {
+        return;
+    }
+    if (!slabs_contain(p, (uintptr_t)ptr >> p->slab_shift)) {
+        allocator_dealloc(p->fallback, ptr);
+        return;
+    }
+    pool_object* o = ptr;
+    o->next = p->free_list;
+    p->free_list = o;
+}
+
+// Allocations of at most object_size bytes always come from the slabs, so
+// knowing the size saves looking up the slab.
+static void pool_deallocate_sized(void* ctx, void* ptr, size_t size) {
+    pool_t* p = ctx;
+
+    if (ptr == NULL) {
+        return;
+    }
+    if (size > p->object_size) {
+        allocator_dealloc_sized(p->fallback, ptr, size);
+        return;
+    }
+    pool_object* o = ptr;
+    o->next = p->free_list;
+    p->free_list = o;
+}
+
+static void* pool_reallocate(void* ctx, void* ptr, size_t old_size,
+                             size_t new_size) {
+    pool_t* p = ctx;
+
+    if (old_size <= p->object_size && new_size <= p->object_size) {
+        return ptr;
+    }
+    if (old_size > p->object_size && new_size > p->object_size) {
+        return allocator_realloc(p->fallback, ptr, old_size, new_size);
+    }
+    // The allocation moves between the slabs and the fallback allocator.
+    void* q = pool_allocate(p, new_size);
+    if (q == NULL) {
+        return NULL;
+    }
+    memcpy(q, ptr, old_size < new_size ? old_size : new_size);
+    pool_deallocate_sized(p, ptr, old_size);
+    return q;
+}
+
+pool_t* pool_make_alloc(size_t object_size, const allocator_t* allocator) {
+    pool_t* p = allocator_alloc(allocator, sizeof(pool_t));
+    if (p == NULL) {
+        return NULL;
+    }
+
+    p->allocator.ctx = p;
+    p->allocator.allocate = pool_allocate;
+    p->allocator.deallocate = pool_deallocate;
+    p->allocator.reallocate = pool_reallocate;
+    p->allocator.deallocate_sized = pool_deallocate_sized;
+    p->fallback = allocator;
+    p->object_size = align_up(
+        object_size < sizeof(pool_object) ? sizeof(pool_object) : object_size,
+        POOL_ALIGNMENT);
+    p->slab_size = POOL_PAGE_SIZE;
+    p->slab_shift = 12;
+    while (p->slab_size < POOL_MIN_OBJECTS_PER_SLAB * p->object_size) {
+        p->slab_size *= 2;
+        ++p->slab_shift;
+    }
+    p->free_list = NULL;
+    p->bump = NULL;
+    p->bump_end = NULL;
+    p->next_slab = NULL;
+    p->chunk_end = NULL;
+    p->chunks = NULL;
+    p->slabs = NULL;
+    p->slabs_capacity = 0;
+    p->nb_slabs = 0;
+
+    return p;
+}
+
+pool_t* pool_make(size_t object_size) {
+    return pool_make_alloc(object_size, &default_allocator);
+}
+
+void pool_del(pool_t* p) {
+    if (p == NULL) {
+        return;
+    }
+    while (p->chunks != NULL) {
+        pool_chunk* c = p->chunks;
+        p->chunks = c->next;
+        allocator_dealloc(p->fallback, c);
+    }
+    allocator_dealloc(p->fallback, p->slabs);
+    allocator_dealloc(p->fallback, p);
+}
+
+const allocator_t* pool_allocator(pool_t* p) { return &p->allocator; }
@@ -0,0 +1,209 @@
+#include "delta/segvec.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "delta/allocator.h"
+#include "delta/vec.h"
+#include "vec_header.h"
+
+#define SEGVEC_FIRST_CHUNK_LEN 8
+#define SEGVEC_MAX_CHUNK_SIZE (1 << 20)
+
+typedef struct segvec {
+    size_t value_size;
+    const allocator_t* allocator;
+
+    // log2 of the first and of the maximum chunk lengths.
+    unsigned first_shift;
+    unsigned max_shift;
+    // Number of elements stored in the geometrically sized chunks.
+    size_t geometric_len;
+
+    // Chunk directory. chunks[0] is the chunk number first_chunk.
+    char** chunks;
+    size_t first_chunk;
+
+    size_t begin;
+    size_t end;
+    // Index following the last element of the last allocated chunk.
+    size_t capacity;
+} segvec;
+
+static unsigned log2_floor(size_t n) {
+    return (unsigned)(sizeof(unsigned long long) * 8 - 1) -
+           (unsigned)__builtin_clzll((unsigned long long)n);
+}
+
+static unsigned log2_ceil(size_t n) {
+    return n <= 1 ? 0 : log2_floor(n - 1) + 1;
+}
+
+// Number of geometrically sized chunks.
+#define nb_geometric_chunks(sv) ((sv)->max_shift - (sv)->first_shift + 1)
+
+// Returns the number of elements of the chunk number k.
+static size_t chunk_len(const segvec* sv, size_t k) {
+    if (k < nb_geometric_chunks(sv)) {
+        return (size_t)1 << (sv->first_shift + k);
+    }
+    return (size_t)1 << sv->max_shift;
+}
+
+// Returns the index of the first element of the chunk number k.
+static size_t chunk_begin(const segvec* sv, size_t k) {
+    if (k < nb_geometric_chunks(sv)) {
+        return (((size_t)1 << k) - 1) << sv->first_shift;
+    }
+    return sv->geometric_len +
+           ((k - nb_geometric_chunks(sv)) << sv->max_shift);
+}
+
+// Returns the chunk number holding the element at index i and stores the
+// position of the element in this chunk at the address pointed to by offset.
+static size_t chunk_of(const segvec* sv, size_t i, size_t* offset) {
+    if (i < sv->geometric_len) {
+        // Chunk k starts at index (2^k - 1) * first_chunk_len, so biasing the
+        // index by first_chunk_len makes the chunk number its log2.
+        const size_t j = i + ((size_t)1 << sv->first_shift);
+        const unsigned msb = log2_floor(j);
+        *offset = j - ((size_t)1 << msb);
+        return msb - sv->first_shift;
+    }
+    i -= sv->geometric_len;
+    *offset = i & (((size_t)1 << sv->max_shift) - 1);
+    return nb_geometric_chunks(sv) + (i >> sv->max_shift);
+}
+
+segvec_config_t segvec_config(size_t value_size) {
+    segvec_config_t c;
+    c.value_size = value_size;
+    c.first_chunk_len = SEGVEC_FIRST_CHUNK_LEN;
+    c.max_chunk_len = (size_t)1 << log2_floor(
+        value_size < SEGVEC_MAX_CHUNK_SIZE ? SEGVEC_MAX_CHUNK_SIZE / value_size
+                                           : 1);
+    c.allocator = &default_allocator;
+    return c;
+}
+
+segvec_t segvec_make_from_config(const segvec_config_t* config) {
+    segvec* sv = allocator_alloc(config->allocator, sizeof(segvec));
+    if (sv == NULL) {
+        return NULL;
+    }
+
+    sv->value_size = config->value_size;
+    sv->allocator = config->allocator;
+    sv->first_shift = log2_ceil(config->first_chunk_len);
+    sv->max_shift = log2_ceil(config->max_chunk_len);
+    if (sv->max_shift < sv->first_shift) {
+        sv->max_shift = sv->first_shift;
+    }
+    sv->geometric_len = chunk_begin(sv, nb_geometric_chunks(sv) - 1) +
+                        chunk_len(sv, nb_geometric_chunks(sv) - 1);
+
+    sv->chunks = vec_make_alloc(char*, 0, 8, sv->allocator);
+    if (sv->chunks == NULL) {
+        allocator_dealloc(sv->allocator, sv);
+        return NULL;
+    }
+    sv->first_chunk = 0;
+    sv->begin = 0;
+    sv->end = 0;
+    sv->capacity = 0;
+
+    return sv;
+}
+
+segvec_t segvec_make(size_t value_size) {
+    segvec_config_t config = segvec_config(value_size);
+    return segvec_make_from_config(&config);
+}
+
+void segvec_del(segvec_t s) {
+    segvec* sv = s;
+    if (sv == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < vec_len(sv->chunks); ++i) {
+        allocator_dealloc(sv->allocator, sv->chunks[i]);
+    }
+    vec_del(sv->chunks);
+    allocator_dealloc(sv->allocator, sv);
+}
+
+size_t segvec_len(const segvec_t s) {
+    const segvec* sv = s;
+    return sv->end - sv->begin;
+}
+
+size_t segvec_begin(const segvec_t s) {
+    const segvec* sv = s;
+    return sv->begin;
+}
+
+size_t segvec_end(const segvec_t s) {
+    const segvec* sv = s;
+    return sv->end;
+}
+
+void* segvec_at(const segvec_t s, size_t i) {
+    const segvec* sv = s;
+    size_t offset = 0;
+    assert(i >= sv->begin && i < sv->end);
+    const size_t k = chunk_of(sv, i, &offset);
+    return sv->chunks[k - sv->first_chunk] + offset * sv->value_size;
+}
+
+void* segvec_append(segvec_t s, const void* val_ptr) {
+    segvec* sv = s;
+
+    if (sv->end == sv->capacity) {
+        // Allocate the next chunk. Only the directory may be reallocated.
+        const size_t k = sv->first_chunk + vec_len(sv->chunks);
+        const size_t len = chunk_len(sv, k);
+        char* chunk = allocator_alloc(sv->allocator, len * sv->value_size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        vec_append(&sv->chunks, chunk);
+        if (!vec_valid(sv->chunks)) {
+            // The directory failed to grow and is left untouched, only set as
+            // invalid: set it as valid again so that the next appends retry.
+            get_vec_header(sv->chunks)->valid = true;
+            allocator_dealloc(sv->allocator, chunk);
+            return NULL;
+        }
+        sv->capacity += len;
+    }
+
+    ++sv->end;
+    void* v = segvec_at(sv, sv->end - 1);
+    memcpy(v, val_ptr, sv->value_size);
+    return v;
+}
+
+void segvec_pop_front(segvec_t s, size_t n) {
+    segvec* sv = s;
+    size_t offset = 0;
+
+    sv->begin = n < sv->end - sv->begin ? sv->begin + n : sv->end;
+
+    // Free the chunks preceding the one holding the first element. If all the
+    // allocated chunks are full and empty, this is the chunk following the
+    // last allocated one, so they are all freed.
+    const size_t released =
+        chunk_of(sv, sv->begin, &offset) - sv->first_chunk;
+    if (released == 0) {
+        return;
+    }
+    const size_t nb_chunks = vec_len(sv->chunks);
+    for (size_t i = 0; i < released; ++i) {
+        allocator_dealloc(sv->allocator, sv->chunks[i]);
+    }
+    memmove(sv->chunks, sv->chunks + released,
+            (nb_chunks - released) * sizeof(char*));
+    vec_resize(&sv->chunks, nb_chunks - released);
+    sv->first_chunk += released;
+}
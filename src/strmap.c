@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "delta/allocator.h"
 #include "delta/hash.h"
 
 #define MAPB_CAPA 8
@@ -23,8 +24,7 @@ typedef struct strmap_bucket {
 typedef struct strmap {
     size_t value_size;
     size_t capacity;
-    void* (*malloc_func)(size_t);
-    void* (*realloc_func)(void*, size_t);
+    const allocator_t* allocator;
     int (*strncmp_func)(const char*, const char*, size_t);
 
     size_t len;
@@ -35,10 +35,13 @@ typedef struct strmap {
     char* keys;
     size_t keys_len;
     size_t keys_capacity;
+    /* Size of the erased keys left in the keys buffer. */
+    size_t keys_erased;
 } strmap;
 
 static void* init_new_bucket(const strmap* m, strmap_bucket* b) {
-    if ((b->values = m->malloc_func(m->value_size * MAPB_CAPA)) == NULL) {
+    if ((b->values = allocator_alloc(m->allocator,
+                                     m->value_size * MAPB_CAPA)) == NULL) {
         return NULL;
     }
     b->len = 0;
@@ -50,8 +53,7 @@ strmap_config_t strmap_config(size_t value_size, size_t capacity) {
     strmap_config_t c;
     c.value_size = value_size;
     c.capacity = capacity;
-    c.malloc_func = &malloc;
-    c.realloc_func = &realloc;
+    c.allocator = &default_allocator;
     c.strncmp_func = &strncmp;
     return c;
 }
@@ -60,34 +62,34 @@ strmap_t strmap_make_from_config(const strmap_config_t* config) {
     strmap* m = NULL;
     size_t i = 0;
 
-    if ((m = config->malloc_func(sizeof(strmap))) == NULL) {
+    if ((m = allocator_alloc(config->allocator, sizeof(strmap))) == NULL) {
         return NULL;
     }
 
     m->value_size = config->value_size;
     m->capacity = config->capacity;
-    m->malloc_func = config->malloc_func;
-    m->realloc_func = config->realloc_func;
+    m->allocator = config->allocator;
     m->strncmp_func = config->strncmp_func;
 
-    if (m->capacity == 0) {
-        ++m->capacity;
-    }
-    while (m->capacity % 8 != 0) {
-        ++m->capacity;
+    /* The number of buckets must be a power of 2 for bucket_pos. */
+    size_t capacity = MAPB_CAPA;
+    while (capacity < m->capacity) {
+        capacity <<= 1;
     }
+    m->capacity = capacity;
 
     m->len = 0;
 
     m->hash_seed = 13;
     m->nb_buckets = m->capacity / MAPB_CAPA;
-    if ((m->buckets = m->malloc_func(sizeof(strmap_bucket) * m->nb_buckets)) ==
-        NULL) {
+    if ((m->buckets = allocator_alloc(
+             m->allocator, sizeof(strmap_bucket) * m->nb_buckets)) == NULL) {
         return NULL;
     }
     m->keys_len = 0;
+    m->keys_erased = 0;
     m->keys_capacity = 1024;
-    if ((m->keys = m->malloc_func(m->keys_capacity)) == NULL) {
+    if ((m->keys = allocator_alloc(m->allocator, m->keys_capacity)) == NULL) {
         return NULL;
     }
 
@@ -110,21 +112,24 @@ void strmap_del(strmap_t map) {
     strmap* m = map;
     size_t i = 0;
 
+    const size_t values_size = m->value_size * MAPB_CAPA;
+
     for (i = 0; i < m->nb_buckets; ++i) {
         strmap_bucket* b = &m->buckets[i];
-        free(b->values);
+        allocator_dealloc_sized(m->allocator, b->values, values_size);
         b = b->next;
         while (b != NULL) {
             strmap_bucket* cur = b;
-            free(cur->values);
+            allocator_dealloc_sized(m->allocator, cur->values, values_size);
             b = cur->next;
-            free(cur);
+            allocator_dealloc_sized(m->allocator, cur, sizeof(strmap_bucket));
         }
     }
 
-    free(m->buckets);
-    free(m->keys);
-    free(m);
+    allocator_dealloc_sized(m->allocator, m->buckets,
+                            sizeof(strmap_bucket) * m->nb_buckets);
+    allocator_dealloc_sized(m->allocator, m->keys, m->keys_capacity);
+    allocator_dealloc_sized(m->allocator, m, sizeof(strmap));
 }
 
 size_t strmap_len(const strmap_t map) {
@@ -154,7 +159,10 @@ static int find_bucket_pos(const strmap* m, const char* key, size_t key_len,
         for (i = 0; i < b->len; ++i) {
             if (h == b->hash[i]) {
                 const char* bkey = m->keys + b->key_positions[i];
-                if (m->strncmp_func(key, bkey, key_len) != 0) {
+                /* The key may not be NUL-terminated, so check that the stored
+                 * key isn't longer. */
+                if (m->strncmp_func(key, bkey, key_len) != 0 ||
+                    bkey[key_len] != 0) {
                     continue;
                 }
                 break;
@@ -200,24 +208,42 @@ int strmap_get_withlen(const strmap_t map, const char* key, size_t key_len,
     return 1;
 }
 
-int strmap_erase(strmap_t map, const char* key) {
+int strmap_erase_withlen(strmap_t map, const char* key, size_t key_len) {
     strmap* m = map;
     strmap_bucket* b = NULL;
     size_t pos = 0;
     unsigned long h = 0;
-    const size_t key_len = strlen(key);
 
     if (!find_bucket_pos(m, key, key_len, &h, &b, &pos)) {
         return 0;
     }
-    if (b->len > 1) {
-        b->hash[pos] = b->hash[b->len - 1];
-        b->key_positions[pos] = b->key_positions[b->len - 1];
-        memcpy(bucket_val(m, b, pos), bucket_val(m, b, b->len - 1),
+
+    /* Move the last pair of the chain of buckets to the erased one, so that
+     * only the last bucket of a chain has free slots: insertions fill it, and
+     * it is freed once empty. */
+    strmap_bucket* prev = NULL;
+    strmap_bucket* last = &m->buckets[bucket_pos(m, h)];
+    while (last->next != NULL) {
+        prev = last;
+        last = last->next;
+    }
+    const size_t last_pos = last->len - 1;
+    if (last != b || last_pos != pos) {
+        b->hash[pos] = last->hash[last_pos];
+        b->key_positions[pos] = last->key_positions[last_pos];
+        memcpy(bucket_val(m, b, pos), bucket_val(m, last, last_pos),
                m->value_size);
     }
-    --b->len;
+    --last->len;
     --m->len;
+    m->keys_erased += key_len + 1;
+
+    if (last->len == 0 && prev != NULL) {
+        prev->next = NULL;
+        allocator_dealloc_sized(m->allocator, last->values,
+                                m->value_size * MAPB_CAPA);
+        allocator_dealloc_sized(m->allocator, last, sizeof(strmap_bucket));
+    }
 
     return 1;
 }
@@ -230,17 +256,24 @@ int strmap_erase(strmap_t map, const char* key) {
 static size_t append_new_key(strmap* m, const char* key, size_t key_len) {
     size_t key_pos = 0;
 
-    ++key_len;
-    while (m->keys_len + key_len > m->keys_capacity) {
-        m->keys_capacity *= 2;
-        if ((m->keys = m->realloc_func(m->keys, m->keys_capacity)) == NULL) {
+    if (m->keys_len + key_len + 1 > m->keys_capacity) {
+        size_t capacity = m->keys_capacity;
+        char* keys = NULL;
+        while (m->keys_len + key_len + 1 > capacity) {
+            capacity *= 2;
+        }
+        if ((keys = allocator_realloc(m->allocator, m->keys,
+                                      m->keys_capacity, capacity)) == NULL) {
             return SIZE_MAX;
         }
+        m->keys = keys;
+        m->keys_capacity = capacity;
     }
 
     key_pos = m->keys_len;
     memcpy(m->keys + key_pos, key, key_len);
-    m->keys_len += key_len;
+    m->keys[key_pos + key_len] = 0;
+    m->keys_len += key_len + 1;
 
     return key_pos;
 }
@@ -249,11 +282,11 @@ static size_t append_new_key(strmap* m, const char* key, size_t key_len) {
  * Insert a new key/value pair in the map and return a pointer to the map.
  * NULL is returned in case of error.
  */
-static void* strmap_insert(strmap* m, const char* key, const void* val_ptr) {
+static void* strmap_insert(strmap* m, const char* key, size_t key_len,
+                           const void* val_ptr) {
     strmap_bucket* b = NULL;
     size_t pos = 0;
     unsigned long h = 0;
-    const size_t key_len = strlen(key);
 
     if (find_bucket_pos(m, key, key_len, &h, &b, &pos)) {
         memcpy(bucket_val(m, b, pos), val_ptr, m->value_size);
@@ -262,7 +295,8 @@ static void* strmap_insert(strmap* m, const char* key, const void* val_ptr) {
     pos = b->len;
 
     if (pos == MAPB_CAPA) {
-        if ((b->next = malloc(sizeof(strmap_bucket))) == NULL) {
+        if ((b->next = allocator_alloc(m->allocator, sizeof(strmap_bucket))) ==
+            NULL) {
             return NULL;
         }
         if ((b = init_new_bucket(m, b->next)) == NULL) {
@@ -282,19 +316,23 @@ static void* strmap_insert(strmap* m, const char* key, const void* val_ptr) {
 }
 
 /*
- * Increase the map capacity by 2 and rehashs the existing key/value pairs.
+ * Rehashs the existing key/value pairs in a map of the given capacity, which
+ * only stores the keys which weren't erased.
  * A pointer to the rehased map is returned.
  * NULL is returned in case of error.
  */
-static strmap* strmap_rehash(strmap* m) {
-    strmap* n = strmap_make(m->value_size, m->capacity * 2);
+static strmap* strmap_rehash(strmap* m, size_t capacity) {
+    strmap_config_t config = strmap_config(m->value_size, capacity);
+    config.allocator = m->allocator;
+    config.strncmp_func = m->strncmp_func;
+    strmap* n = strmap_make_from_config(&config);
     strmap_iterator_t it = strmap_iterator(m);
     if (n == NULL) {
         return NULL;
     }
 
     while (strmap_next(&it)) {
-        if (strmap_insert(n, it.key, it.val_ptr) == NULL) {
+        if (strmap_insert(n, it.key, strlen(it.key), it.val_ptr) == NULL) {
             return NULL;
         }
     }
@@ -304,21 +342,29 @@ static strmap* strmap_rehash(strmap* m) {
     return n;
 }
 
-strmap_t strmap_addp(strmap_t map, const char* key, const void* val_ptr) {
+strmap_t strmap_addp_withlen(strmap_t map, const char* key, size_t key_len,
+                             const void* val_ptr) {
     strmap* m = map;
     double load_factor = (double)(m->len);
 
     load_factor /= (double)m->nb_buckets;
     if (load_factor > MAP_MAX_LOAD_FACTOR) {
-        if ((m = strmap_rehash(m)) == NULL) {
+        if ((m = strmap_rehash(m, m->capacity * 2)) == NULL) {
+            return NULL;
+        }
+    } else if (m->keys_erased > m->keys_len / 2 && m->keys_len > 1024) {
+        /* Erased keys fill most of the keys buffer: compact it, so that a map
+         * whose keys are replaced doesn't grow without bound. */
+        if ((m = strmap_rehash(m, m->capacity)) == NULL) {
             return NULL;
         }
     }
 
-    return strmap_insert(m, key, val_ptr);
+    return strmap_insert(m, key, key_len, val_ptr);
 }
 
-strmap_t strmap_addv(strmap_t map, const char* key, ...) {
+strmap_t strmap_addv_withlen(strmap_t map, const char* key, size_t key_len,
+                             ...) {
     strmap* m = map;
     int8_t i8 = 0;
     int16_t i16 = 0;
@@ -326,22 +372,22 @@ strmap_t strmap_addv(strmap_t map, const char* key, ...) {
     int64_t i64 = 0;
     va_list args;
 
-    va_start(args, key);
+    va_start(args, key_len);
     i64 = va_arg(args, int64_t);
     va_end(args);
 
     switch (m->value_size) {
         case sizeof(int8_t):
             i8 = (int8_t)i64;
-            return strmap_addp(m, key, &i8);
+            return strmap_addp_withlen(m, key, key_len, &i8);
         case sizeof(int16_t):
             i16 = (int16_t)i64;
-            return strmap_addp(m, key, &i16);
+            return strmap_addp_withlen(m, key, key_len, &i16);
         case sizeof(int32_t):
             i32 = (int32_t)i64;
-            return strmap_addp(m, key, &i32);
+            return strmap_addp_withlen(m, key, key_len, &i32);
         case sizeof(int64_t):
-            return strmap_addp(m, key, &i64);
+            return strmap_addp_withlen(m, key, key_len, &i64);
         default:
             assert(0 && "unsupported value data size");
     }
@@ -0,0 +1,208 @@
+#include "delta/strset.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "delta/allocator.h"
+#include "delta/arena.h"
+#include "delta/hash.h"
+
+// Seed of the hashes, the one of strmap.
+#define STRSET_HASH_SEED 13
+
+// Minimum number of slots, a power of 2.
+#define STRSET_MIN_SLOTS 16
+
+// The table grows when more than 3/4 of its slots are used.
+#define STRSET_MAX_LOAD(nb_slots) ((nb_slots) / 4 * 3)
+
+// An interned string.
+typedef struct strset_entry {
+    const char* str;
+    size_t len;
+    // Hash of the string, so that the table grows without hashing again.
+    size_t hash;
+} strset_entry;
+
+// A slot of the table: the id of a string, or STRSET_NONE if the slot is free,
+// and the high bits of its hash, so that the probes only read the entries of
+// the strings which likely match.
+typedef struct strset_slot {
+    uint32_t id;
+    uint32_t tag;
+} strset_slot;
+
+struct strset {
+    const allocator_t* allocator;
+    // Copies of the strings.
+    arena_t* strings;
+
+    // Strings by id.
+    strset_entry* entries;
+    size_t len;
+    size_t capacity;
+
+    // Open addressing table, probed linearly.
+    strset_slot* slots;
+    size_t nb_slots;
+};
+
+#define slot_tag(h) ((uint32_t)((uint64_t)(h) >> 32))
+
+// Returns a free table of nb_slots slots, or NULL in case of error.
+static strset_slot* make_slots(const allocator_t* allocator, size_t nb_slots) {
+    strset_slot* slots =
+        allocator_alloc(allocator, nb_slots * sizeof(strset_slot));
+    for (size_t i = 0; slots != NULL && i < nb_slots; ++i) {
+        slots[i].id = STRSET_NONE;
+        slots[i].tag = 0;
+    }
+    return slots;
+}
+
+// Returns the slot of the string of hash h, or the free slot where it belongs
+// if it isn't interned.
+static strset_slot* find_slot(const strset_t* set, const char* s, size_t len,
+                              size_t h) {
+    const uint32_t tag = slot_tag(h);
+    size_t pos = h & (set->nb_slots - 1);
+    while (1) {
+        strset_slot* slot = &set->slots[pos];
+        if (slot->id == STRSET_NONE) {
+            return slot;
+        }
+        if (slot->tag == tag) {
+            const strset_entry* e = &set->entries[slot->id];
+            if (e->hash == h && e->len == len && memcmp(e->str, s, len) == 0) {
+                return slot;
+            }
+        }
+        pos = (pos + 1) & (set->nb_slots - 1);
+    }
+}
+
+// Doubles the number of slots. Returns false in case of error.
+static bool grow_slots(strset_t* set) {
+    const size_t nb_slots = set->nb_slots * 2;
+    strset_slot* slots = make_slots(set->allocator, nb_slots);
+    if (slots == NULL) {
+        return false;
+    }
+    for (size_t id = 0; id < set->len; ++id) {
+        const size_t h = set->entries[id].hash;
+        size_t pos = h & (nb_slots - 1);
+        while (slots[pos].id != STRSET_NONE) {
+            pos = (pos + 1) & (nb_slots - 1);
+        }
+        slots[pos].id = (uint32_t)id;
+        slots[pos].tag = slot_tag(h);
+    }
+    allocator_dealloc_sized(set->allocator, set->slots,
+                            set->nb_slots * sizeof(strset_slot));
+    set->slots = slots;
+    set->nb_slots = nb_slots;
+    return true;
+}
+
+strset_t* strset_make_alloc(size_t capacity, const allocator_t* allocator) {
+    strset_t* set = allocator_alloc(allocator, sizeof(strset_t));
+    if (set == NULL) {
+        return NULL;
+    }
+    set->allocator = allocator;
+    set->len = 0;
+    set->capacity = capacity < STRSET_MIN_SLOTS ? STRSET_MIN_SLOTS : capacity;
+    set->nb_slots = STRSET_MIN_SLOTS;
+    while (STRSET_MAX_LOAD(set->nb_slots) < set->capacity) {
+        set->nb_slots *= 2;
+    }
+    set->strings = arena_make_alloc(0, allocator);
+    set->entries =
+        allocator_alloc(allocator, set->capacity * sizeof(strset_entry));
+    set->slots = make_slots(allocator, set->nb_slots);
+    if (set->strings == NULL || set->entries == NULL || set->slots == NULL) {
+        strset_del(set);
+        return NULL;
+    }
+    return set;
+}
+
+strset_t* strset_make(size_t capacity) {
+    return strset_make_alloc(capacity, &default_allocator);
+}
+
+void strset_del(strset_t* set) {
+    if (set == NULL) {
+        return;
+    }
+    arena_del(set->strings);
+    if (set->entries != NULL) {
+        allocator_dealloc_sized(set->allocator, set->entries,
+                                set->capacity * sizeof(strset_entry));
+    }
+    if (set->slots != NULL) {
+        allocator_dealloc_sized(set->allocator, set->slots,
+                                set->nb_slots * sizeof(strset_slot));
+    }
+    allocator_dealloc_sized(set->allocator, set, sizeof(strset_t));
+}
+
+size_t strset_len(const strset_t* set) { return set->len; }
+
+uint32_t strset_intern_withlen(strset_t* set, const char* s, size_t len) {
+    const size_t h = hash_bytes(s, len, STRSET_HASH_SEED);
+    strset_slot* slot = find_slot(set, s, len, h);
+    if (slot->id != STRSET_NONE) {
+        return slot->id;
+    }
+    if (set->len == STRSET_NONE) {
+        return STRSET_NONE;
+    }
+
+    // make room first, so that a failure leaves the set untouched
+    if (set->len == set->capacity) {
+        const size_t capacity = set->capacity * 2;
+        strset_entry* entries = allocator_realloc(
+            set->allocator, set->entries, set->capacity * sizeof(strset_entry),
+            capacity * sizeof(strset_entry));
+        if (entries == NULL) {
+            return STRSET_NONE;
+        }
+        set->entries = entries;
+        set->capacity = capacity;
+    }
+    if (set->len + 1 > STRSET_MAX_LOAD(set->nb_slots)) {
+        if (!grow_slots(set)) {
+            return STRSET_NONE;
+        }
+        slot = find_slot(set, s, len, h);
+    }
+    char* str = allocator_alloc(arena_allocator(set->strings), len + 1);
+    if (str == NULL) {
+        return STRSET_NONE;
+    }
+    memcpy(str, s, len);
+    str[len] = 0;
+
+    const uint32_t id = (uint32_t)set->len++;
+    set->entries[id].str = str;
+    set->entries[id].len = len;
+    set->entries[id].hash = h;
+    slot->id = id;
+    slot->tag = slot_tag(h);
+    return id;
+}
+
+uint32_t strset_find_withlen(const strset_t* set, const char* s, size_t len) {
+    const size_t h = hash_bytes(s, len, STRSET_HASH_SEED);
+    return find_slot(set, s, len, h)->id;
+}
+
+const char* strset_str(const strset_t* set, uint32_t id) {
+    return set->entries[id].str;
+}
+
+size_t strset_strlen(const strset_t* set, uint32_t id) {
+    return set->entries[id].len;
+}
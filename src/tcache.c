@@ -0,0 +1,395 @@
+#include "delta/tcache.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "delta/allocator.h"
+
+// Size classes are 16 bytes apart up to 128 bytes, then split every power of 2
+// in 4 classes up to TCACHE_MAX_SIZE. Sizes include the object header.
+#define TCACHE_NB_SMALL_CLASSES 8
+#define TCACHE_NB_CLASSES (TCACHE_NB_SMALL_CLASSES + 4 * 8)
+#define TCACHE_MAX_SIZE (32 * 1024)
+#define TCACHE_LARGE SIZE_MAX
+#define TCACHE_SPAN_SIZE (64 * 1024)
+#define TCACHE_MAX_BATCH 32
+
+// Header of every object. The next pointer is only used while the object is
+// free.
+typedef struct tcache_object {
+    size_t cls;
+    struct tcache_object* next;
+} tcache_object;
+
+// Free objects of a size class, either cached by a thread or in the central
+// heap.
+typedef struct tcache_list {
+    tcache_object* head;
+    size_t len;
+} tcache_list;
+
+typedef struct thread_cache {
+    tcache_t* owner;
+    struct thread_cache* prev;
+    struct thread_cache* next;
+    tcache_list lists[TCACHE_NB_CLASSES];
+} thread_cache;
+
+typedef struct central_list {
+    pthread_mutex_t lock;
+    tcache_list list;
+} central_list;
+
+// Spans are the blocks objects are carved from.
+typedef struct tcache_span {
+    struct tcache_span* next;
+    size_t _;
+} tcache_span;
+
+struct tcache {
+    allocator_t allocator;
+    const allocator_t* backing;
+    pthread_key_t key;
+    size_t sizes[TCACHE_NB_CLASSES];
+    size_t batches[TCACHE_NB_CLASSES];
+    central_list central[TCACHE_NB_CLASSES];
+
+    // Protects spans and caches.
+    pthread_mutex_t lock;
+    tcache_span* spans;
+    thread_cache* caches;
+};
+
+static unsigned log2_floor(size_t n) {
+    return (unsigned)(sizeof(unsigned long long) * 8 - 1) -
+           (unsigned)__builtin_clzll((unsigned long long)n);
+}
+
+// Returns the class of the objects of size bytes, header included.
+static size_t size_class(size_t size) {
+    if (size <= 16 * TCACHE_NB_SMALL_CLASSES) {
+        return (size + 15) / 16 - 1;
+    }
+    // 2^p < size <= 2^(p+1), and the classes of this range are 2^(p-2) apart.
+    const unsigned p = log2_floor(size - 1);
+    const size_t k = (size - ((size_t)1 << p) + ((size_t)1 << (p - 2)) - 1) >>
+                     (p - 2);
+    return TCACHE_NB_SMALL_CLASSES + (p - 7) * 4 + (k - 1);
+}
+
+static size_t class_size(size_t cls) {
+    if (cls < TCACHE_NB_SMALL_CLASSES) {
+        return (cls + 1) * 16;
+    }
+    const unsigned p = (unsigned)(cls - TCACHE_NB_SMALL_CLASSES) / 4 + 7;
+    const size_t k = (cls - TCACHE_NB_SMALL_CLASSES) % 4 + 1;
+    return ((size_t)1 << p) + (k << (p - 2));
+}
+
+// Pops n objects of the list, which must hold at least n objects, and returns
+// them as a list.
+static tcache_list list_pop(tcache_list* l, size_t n) {
+    tcache_list batch = {l->head, n};
+    tcache_object* last = l->head;
+    for (size_t i = 1; i < n; ++i) {
+        last = last->next;
+    }
+    l->head = last->next;
+    l->len -= n;
+    last->next = NULL;
+    return batch;
+}
+
+static void list_push(tcache_list* l, tcache_list batch) {
+    if (batch.len == 0) {
+        return;
+    }
+    tcache_object* last = batch.head;
+    while (last->next != NULL) {
+        last = last->next;
+    }
+    last->next = l->head;
+    l->head = batch.head;
+    l->len += batch.len;
+}
+
+static void central_push(tcache_t* t, size_t cls, tcache_list batch) {
+    central_list* c = &t->central[cls];
+    pthread_mutex_lock(&c->lock);
+    list_push(&c->list, batch);
+    pthread_mutex_unlock(&c->lock);
+}
+
+// Carves a new span into objects of the class and adds them to the central
+// list, whose lock must be held. Returns 0 in case of error.
+static int central_grow(tcache_t* t, size_t cls) {
+    const size_t size = t->sizes[cls];
+    size_t span_size = sizeof(tcache_span) + t->batches[cls] * size;
+    if (span_size < TCACHE_SPAN_SIZE) {
+        span_size = TCACHE_SPAN_SIZE;
+    }
+    tcache_span* span = allocator_alloc(t->backing, span_size);
+    if (span == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&t->lock);
+    span->next = t->spans;
+    t->spans = span;
+    pthread_mutex_unlock(&t->lock);
+
+    tcache_list* l = &t->central[cls].list;
+    char* end = (char*)span + span_size - size;
+    for (char* p = (char*)(span + 1); p <= end; p += size) {
+        tcache_object* o = (tcache_object*)p;
+        o->cls = cls;
+        o->next = l->head;
+        l->head = o;
+        ++l->len;
+    }
+    return 1;
+}
+
+// Moves a batch of objects from the central heap to the thread cache.
+// Returns 0 in case of error.
+static int refill(tcache_t* t, thread_cache* tc, size_t cls) {
+    central_list* c = &t->central[cls];
+    pthread_mutex_lock(&c->lock);
+    if (c->list.len == 0 && !central_grow(t, cls)) {
+        pthread_mutex_unlock(&c->lock);
+        return 0;
+    }
+    const size_t n =
+        c->list.len < t->batches[cls] ? c->list.len : t->batches[cls];
+    tcache_list batch = list_pop(&c->list, n);
+    pthread_mutex_unlock(&c->lock);
+
+    tc->lists[cls] = batch;
+    return 1;
+}
+
+static void flush(thread_cache* tc) {
+    for (size_t cls = 0; cls < TCACHE_NB_CLASSES; ++cls) {
+        central_push(tc->owner, cls, tc->lists[cls]);
+        tc->lists[cls].head = NULL;
+        tc->lists[cls].len = 0;
+    }
+}
+
+// Called on thread exit.
+static void thread_cache_del(void* ptr) {
+    thread_cache* tc = ptr;
+    tcache_t* t = tc->owner;
+
+    flush(tc);
+    pthread_mutex_lock(&t->lock);
+    if (tc->prev != NULL) {
+        tc->prev->next = tc->next;
+    } else {
+        t->caches = tc->next;
+    }
+    if (tc->next != NULL) {
+        tc->next->prev = tc->prev;
+    }
+    pthread_mutex_unlock(&t->lock);
+    allocator_dealloc(t->backing, tc);
+}
+
+// Returns the cache of the calling thread, which is created on first use.
+// NULL is returned in case of error.
+static thread_cache* get_thread_cache(tcache_t* t) {
+    thread_cache* tc = pthread_getspecific(t->key);
+    if (tc != NULL) {
+        return tc;
+    }
+    if ((tc = allocator_alloc(t->backing, sizeof(thread_cache))) == NULL) {
+        return NULL;
+    }
+    memset(tc, 0, sizeof(thread_cache));
+    tc->owner = t;
+    if (pthread_setspecific(t->key, tc) != 0) {
+        allocator_dealloc(t->backing, tc);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&t->lock);
+    tc->next = t->caches;
+    if (t->caches != NULL) {
+        t->caches->prev = tc;
+    }
+    t->caches = tc;
+    pthread_mutex_unlock(&t->lock);
+
+    return tc;
+}
+
+static void* tcache_allocate(void* ctx, size_t n) {
+    tcache_t* t = ctx;
+    tcache_object* o = NULL;
+
+    if (n > TCACHE_MAX_SIZE - sizeof(tcache_object)) {
+        if ((o = allocator_alloc(t->backing, n + sizeof(tcache_object))) ==
+            NULL) {
+            return NULL;
+        }
+        o->cls = TCACHE_LARGE;
+        return o + 1;
+    }
+
+    const size_t cls = size_class(n + sizeof(tcache_object));
+    thread_cache* tc = get_thread_cache(t);
+    if (tc == NULL) {
+        return NULL;
+    }
+    tcache_list* l = &tc->lists[cls];
+    if (l->len == 0 && !refill(t, tc, cls)) {
+        return NULL;
+    }
+    o = l->head;
+    l->head = o->next;
+    --l->len;
+    return o + 1;
+}
+
+// Gives a small object of the class back to the cache of the calling thread.
+static void cache_object(tcache_t* t, tcache_object* o, size_t cls) {
+    thread_cache* tc = get_thread_cache(t);
+    if (tc == NULL) {
+        // Give the object back to the central heap directly.
+        o->next = NULL;
+        central_push(t, cls, (tcache_list){o, 1});
+        return;
+    }
+    tcache_list* l = &tc->lists[cls];
+    o->next = l->head;
+    l->head = o;
+    if (++l->len > 2 * t->batches[cls]) {
+        central_push(t, cls, list_pop(l, t->batches[cls]));
+    }
+}
+
+static void tcache_deallocate(void* ctx, void* ptr) {
+    tcache_t* t = ctx;
+
+    if (ptr == NULL) {
+        return;
+    }
+    tcache_object* o = (tcache_object*)ptr - 1;
+    if (o->cls == TCACHE_LARGE) {
+        allocator_dealloc(t->backing, o);
+        return;
+    }
+    cache_object(t, o, o->cls);
+}
+
+// Knowing the size gives the class without reading the object header.
+static void tcache_deallocate_sized(void* ctx, void* ptr, size_t size) {
+    tcache_t* t = ctx;
+
+    if (ptr == NULL) {
+        return;
+    }
+    tcache_object* o = (tcache_object*)ptr - 1;
+    if (size > TCACHE_MAX_SIZE - sizeof(tcache_object)) {
+        allocator_dealloc_sized(t->backing, o, size + sizeof(tcache_object));
+        return;
+    }
+    cache_object(t, o, size_class(size + sizeof(tcache_object)));
+}
+
+static void* tcache_reallocate(void* ctx, void* ptr, size_t old_size,
+                               size_t new_size) {
+    tcache_t* t = ctx;
+    const size_t max = TCACHE_MAX_SIZE - sizeof(tcache_object);
+
+    if (old_size > max && new_size > max) {
+        tcache_object* o =
+            allocator_realloc(t->backing, (tcache_object*)ptr - 1,
+                              old_size + sizeof(tcache_object),
+                              new_size + sizeof(tcache_object));
+        return o != NULL ? o + 1 : NULL;
+    }
+    if (old_size <= max && new_size <= max &&
+        size_class(old_size + sizeof(tcache_object)) ==
+            size_class(new_size + sizeof(tcache_object))) {
+        return ptr;
+    }
+
+    void* p = tcache_allocate(t, new_size);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+    tcache_deallocate_sized(t, ptr, old_size);
+    return p;
+}
+
+tcache_t* tcache_make_alloc(const allocator_t* allocator) {
+    tcache_t* t = allocator_alloc(allocator, sizeof(tcache_t));
+    if (t == NULL) {
+        return NULL;
+    }
+    if (pthread_key_create(&t->key, thread_cache_del) != 0) {
+        allocator_dealloc(allocator, t);
+        return NULL;
+    }
+
+    t->allocator.ctx = t;
+    t->allocator.allocate = tcache_allocate;
+    t->allocator.deallocate = tcache_deallocate;
+    t->allocator.reallocate = tcache_reallocate;
+    t->allocator.deallocate_sized = tcache_deallocate_sized;
+    t->backing = allocator;
+    for (size_t cls = 0; cls < TCACHE_NB_CLASSES; ++cls) {
+        t->sizes[cls] = class_size(cls);
+        t->batches[cls] = TCACHE_SPAN_SIZE / 2 / t->sizes[cls];
+        if (t->batches[cls] > TCACHE_MAX_BATCH) {
+            t->batches[cls] = TCACHE_MAX_BATCH;
+        }
+        if (t->batches[cls] < 2) {
+            t->batches[cls] = 2;
+        }
+        pthread_mutex_init(&t->central[cls].lock, NULL);
+        t->central[cls].list.head = NULL;
+        t->central[cls].list.len = 0;
+    }
+    pthread_mutex_init(&t->lock, NULL);
+    t->spans = NULL;
+    t->caches = NULL;
+
+    return t;
+}
+
+tcache_t* tcache_make(void) { return tcache_make_alloc(&default_allocator); }
+
+void tcache_del(tcache_t* t) {
+    if (t == NULL) {
+        return;
+    }
+    pthread_key_delete(t->key);
+    while (t->caches != NULL) {
+        thread_cache* tc = t->caches;
+        t->caches = tc->next;
+        allocator_dealloc(t->backing, tc);
+    }
+    while (t->spans != NULL) {
+        tcache_span* span = t->spans;
+        t->spans = span->next;
+        allocator_dealloc(t->backing, span);
+    }
+    for (size_t cls = 0; cls < TCACHE_NB_CLASSES; ++cls) {
+        pthread_mutex_destroy(&t->central[cls].lock);
+    }
+    pthread_mutex_destroy(&t->lock);
+    allocator_dealloc(t->backing, t);
+}
+
+void tcache_flush(tcache_t* t) {
+    thread_cache* tc = pthread_getspecific(t->key);
+    if (tc != NULL) {
+        flush(tc);
+    }
+}
+
+const allocator_t* tcache_allocator(tcache_t* t) { return &t->allocator; }
@@ -0,0 +1,288 @@
+#include "delta/tracker.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "delta/allocator.h"
+
+#define TRACKER_TAG_LEN 32
+
+typedef struct atomic_stats {
+    atomic_size_t live_bytes;
+    atomic_size_t peak_bytes;
+    atomic_size_t allocations;
+    atomic_size_t deallocations;
+    atomic_size_t histogram[TRACKER_HISTOGRAM_SIZE];
+} atomic_stats;
+
+typedef struct tracker_slot {
+    allocator_t allocator;
+    tracker_t* tracker;
+    size_t index;
+    char name[TRACKER_TAG_LEN];
+    atomic_stats stats;
+} tracker_slot;
+
+struct tracker {
+    const allocator_t* tracked;
+    atomic_stats stats;
+
+    // Protects the creation of tags.
+    pthread_mutex_t lock;
+    atomic_size_t nb_tags;
+    tracker_slot tags[TRACKER_MAX_TAGS];
+};
+
+// Header prepended to every allocation to find its size and tag on
+// deallocation. Its size keeps allocations aligned like malloc'd memory.
+typedef union tracker_header {
+    struct {
+        size_t size;
+        size_t tag;
+    } h;
+    max_align_t _;
+} tracker_header;
+
+static size_t histogram_bucket(size_t size) {
+    if (size <= 1) {
+        return 0;
+    }
+    const size_t b = (size_t)(sizeof(unsigned long long) * 8 - 1) -
+                     (size_t)__builtin_clzll((unsigned long long)size);
+    return b < TRACKER_HISTOGRAM_SIZE ? b : TRACKER_HISTOGRAM_SIZE - 1;
+}
+
+static void record_allocation(atomic_stats* s, size_t size) {
+    const size_t live =
+        atomic_fetch_add_explicit(&s->live_bytes, size, memory_order_relaxed) +
+        size;
+    size_t peak = atomic_load_explicit(&s->peak_bytes, memory_order_relaxed);
+    while (live > peak &&
+           !atomic_compare_exchange_weak_explicit(&s->peak_bytes, &peak, live,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+    atomic_fetch_add_explicit(&s->allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->histogram[histogram_bucket(size)], 1,
+                              memory_order_relaxed);
+}
+
+static void record_deallocation(atomic_stats* s, size_t size) {
+    atomic_fetch_sub_explicit(&s->live_bytes, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->deallocations, 1, memory_order_relaxed);
+}
+
+static void* tracker_allocate(void* ctx, size_t size) {
+    tracker_slot* tag = ctx;
+    tracker_t* t = tag->tracker;
+    tracker_header* header =
+        allocator_alloc(t->tracked, sizeof(tracker_header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->h.size = size;
+    header->h.tag = tag->index;
+    record_allocation(&t->stats, size);
+    record_allocation(&tag->stats, size);
+    return header + 1;
+}
+
+static void tracker_deallocate(void* ctx, void* ptr) {
+    tracker_slot* tag = ctx;
+    tracker_t* t = tag->tracker;
+    if (ptr == NULL) {
+        return;
+    }
+    tracker_header* header = (tracker_header*)ptr - 1;
+    // Charge the tag which allocated the memory, which may differ from the one
+    // of the allocator freeing it.
+    record_deallocation(&t->stats, header->h.size);
+    record_deallocation(&t->tags[header->h.tag].stats, header->h.size);
+    allocator_dealloc(t->tracked, header);
+}
+
+static void tracker_deallocate_sized(void* ctx, void* ptr, size_t size) {
+    tracker_slot* tag = ctx;
+    tracker_t* t = tag->tracker;
+    if (ptr == NULL) {
+        return;
+    }
+    tracker_header* header = (tracker_header*)ptr - 1;
+    (void)size;
+    // The header is read for the tag anyway, and holds the same size.
+    record_deallocation(&t->stats, header->h.size);
+    record_deallocation(&t->tags[header->h.tag].stats, header->h.size);
+    allocator_dealloc_sized(t->tracked, header,
+                            sizeof(tracker_header) + header->h.size);
+}
+
+// A reallocation is recorded as the deallocation of the old size and the
+// allocation of the new one, charged to the tag which allocated the memory.
+static void* tracker_reallocate(void* ctx, void* ptr, size_t old_size,
+                                size_t new_size) {
+    tracker_slot* tag = ctx;
+    tracker_t* t = tag->tracker;
+    tracker_header* header = allocator_realloc(
+        t->tracked, (tracker_header*)ptr - 1, sizeof(tracker_header) + old_size,
+        sizeof(tracker_header) + new_size);
+    if (header == NULL) {
+        return NULL;
+    }
+    atomic_stats* stats = &t->tags[header->h.tag].stats;
+    header->h.size = new_size;
+    record_deallocation(&t->stats, old_size);
+    record_deallocation(stats, old_size);
+    record_allocation(&t->stats, new_size);
+    record_allocation(stats, new_size);
+    return header + 1;
+}
+
+static void stats_init(atomic_stats* s) {
+    atomic_init(&s->live_bytes, 0);
+    atomic_init(&s->peak_bytes, 0);
+    atomic_init(&s->allocations, 0);
+    atomic_init(&s->deallocations, 0);
+    for (size_t i = 0; i < TRACKER_HISTOGRAM_SIZE; ++i) {
+        atomic_init(&s->histogram[i], 0);
+    }
+}
+
+static void stats_reset(atomic_stats* s) {
+    atomic_store(&s->peak_bytes, atomic_load(&s->live_bytes));
+    atomic_store(&s->allocations, 0);
+    atomic_store(&s->deallocations, 0);
+    for (size_t i = 0; i < TRACKER_HISTOGRAM_SIZE; ++i) {
+        atomic_store(&s->histogram[i], 0);
+    }
+}
+
+static tracker_stats_t stats_load(atomic_stats* s) {
+    tracker_stats_t stats;
+    stats.live_bytes = atomic_load(&s->live_bytes);
+    stats.peak_bytes = atomic_load(&s->peak_bytes);
+    stats.allocations = atomic_load(&s->allocations);
+    stats.deallocations = atomic_load(&s->deallocations);
+    for (size_t i = 0; i < TRACKER_HISTOGRAM_SIZE; ++i) {
+        stats.histogram[i] = atomic_load(&s->histogram[i]);
+    }
+    return stats;
+}
+
+static void tag_init(tracker_t* t, size_t index, const char* name) {
+    tracker_slot* tag = &t->tags[index];
+    tag->allocator.ctx = tag;
+    tag->allocator.allocate = tracker_allocate;
+    tag->allocator.deallocate = tracker_deallocate;
+    tag->allocator.reallocate = tracker_reallocate;
+    tag->allocator.deallocate_sized = tracker_deallocate_sized;
+    tag->tracker = t;
+    tag->index = index;
+    strncpy(tag->name, name, TRACKER_TAG_LEN - 1);
+    tag->name[TRACKER_TAG_LEN - 1] = 0;
+    stats_init(&tag->stats);
+}
+
+tracker_t* tracker_make(const allocator_t* allocator) {
+    tracker_t* t = allocator_alloc(allocator, sizeof(tracker_t));
+    if (t == NULL) {
+        return NULL;
+    }
+    t->tracked = allocator;
+    stats_init(&t->stats);
+    pthread_mutex_init(&t->lock, NULL);
+    // Tag 0 records the untagged allocations.
+    tag_init(t, 0, "");
+    atomic_init(&t->nb_tags, 1);
+    return t;
+}
+
+void tracker_del(tracker_t* t) {
+    if (t == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&t->lock);
+    allocator_dealloc(t->tracked, t);
+}
+
+const allocator_t* tracker_allocator(tracker_t* t) {
+    return &t->tags[0].allocator;
+}
+
+// Returns the tag with the given name, or NULL if there is none.
+static tracker_slot* find_tag(tracker_t* t, const char* name) {
+    const size_t n = atomic_load(&t->nb_tags);
+    for (size_t i = 1; i < n; ++i) {
+        if (strncmp(t->tags[i].name, name, TRACKER_TAG_LEN - 1) == 0) {
+            return &t->tags[i];
+        }
+    }
+    return NULL;
+}
+
+const allocator_t* tracker_tag(tracker_t* t, const char* name) {
+    tracker_slot* tag = NULL;
+
+    pthread_mutex_lock(&t->lock);
+    if ((tag = find_tag(t, name)) == NULL) {
+        const size_t n = atomic_load(&t->nb_tags);
+        if (n < TRACKER_MAX_TAGS) {
+            tag_init(t, n, name);
+            tag = &t->tags[n];
+            atomic_store(&t->nb_tags, n + 1);
+        }
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    return tag != NULL ? &tag->allocator : NULL;
+}
+
+tracker_stats_t tracker_snapshot(tracker_t* t, const char* name) {
+    if (name == NULL) {
+        return stats_load(&t->stats);
+    }
+    tracker_slot* tag = find_tag(t, name);
+    if (tag == NULL) {
+        tracker_stats_t zero;
+        memset(&zero, 0, sizeof(zero));
+        return zero;
+    }
+    return stats_load(&tag->stats);
+}
+
+void tracker_reset(tracker_t* t) {
+    const size_t n = atomic_load(&t->nb_tags);
+    stats_reset(&t->stats);
+    for (size_t i = 0; i < n; ++i) {
+        stats_reset(&t->tags[i].stats);
+    }
+}
+
+static void print_stats(FILE* f, const char* name, const tracker_stats_t* s) {
+    fprintf(f, "%-16s live %12zu B  peak %12zu B  allocs %10zu  frees %10zu\n",
+            name, s->live_bytes, s->peak_bytes, s->allocations,
+            s->deallocations);
+}
+
+void tracker_report(tracker_t* t, FILE* f) {
+    const tracker_stats_t total = stats_load(&t->stats);
+    const size_t n = atomic_load(&t->nb_tags);
+
+    print_stats(f, "total", &total);
+    for (size_t i = 0; i < n; ++i) {
+        const tracker_stats_t s = stats_load(&t->tags[i].stats);
+        if (s.allocations == 0 && s.live_bytes == 0) {
+            continue;
+        }
+        print_stats(f, i == 0 ? "(untagged)" : t->tags[i].name, &s);
+    }
+    fprintf(f, "size histogram:\n");
+    for (size_t i = 0; i < TRACKER_HISTOGRAM_SIZE; ++i) {
+        if (total.histogram[i] != 0) {
+            fprintf(f, "  [%zu; %zu[ %zu\n", i == 0 ? 0 : (size_t)1 << i,
+                    (size_t)2 << i, total.histogram[i]);
+        }
+    }
+}
@@ -7,30 +7,17 @@
 #include <string.h>
 
 #include "delta/allocator.h"
+#include "vec_header.h"
 
-typedef struct vec_header {
-    size_t value_size;
-    size_t len;
-    size_t capacity;
-    bool valid;
-    char _[7];
-
-    const allocator_t *_allocator;
-} vec_header;
-
-#define get_vec_header(vec) (((vec_header *)vec) - 1)
-#define get_vec_header_const(vec) (((const vec_header *)vec) - 1)
-
-static vec_header *vec_alloc(const allocator_t *allocator, size_t capacity,
-                             size_t value_size) {
-    return allocator_alloc(
-        allocator,
-        (capacity + 1 /* swap buffer */) * value_size + sizeof(vec_header));
+// Returns the size of the allocation of a vec of the given capacity.
+static size_t vec_alloc_size(size_t capacity, size_t value_size) {
+    return (capacity + 1 /* swap buffer */) * value_size + sizeof(vec_header);
 }
 
 void *vec_make_alloc_impl(size_t value_size, size_t len, size_t capacity,
                           const allocator_t *allocator) {
-    vec_header *s = vec_alloc(allocator, capacity, value_size);
+    vec_header *s =
+        allocator_alloc(allocator, vec_alloc_size(capacity, value_size));
     if (s == NULL) {
         return NULL;
     }
@@ -54,7 +41,9 @@ void vec_del(void *vec) {
         return;
     }
     vec_header *header = get_vec_header(vec);
-    allocator_dealloc(header->_allocator, header);
+    allocator_dealloc_sized(
+        header->_allocator, header,
+        vec_alloc_size(header->capacity, header->value_size));
 }
 
 size_t vec_len(const void *vec) {
@@ -69,37 +58,34 @@ static void vec_grow_capacity(vec_header **header_ptr, size_t n) {
         return;
     }
 
-    bool capacity_changed = false;
     vec_header *header = *header_ptr;
-    if (header->capacity == 0) {
-        header->capacity = 1;
+    size_t capacity = header->capacity == 0 ? 1 : header->capacity;
+    while (header->len + n > capacity) {
+        capacity *= 2;
     }
-    while (header->len + n > header->capacity) {
-        header->capacity *= 2;
-        capacity_changed = true;
+    if (capacity == header->capacity) {
+        return;
     }
 
-    if (capacity_changed) {
-        // Reallocate.
-        vec_header *new_header =
-            vec_alloc(header->_allocator, header->capacity, header->value_size);
-        if (new_header == NULL) {
-            header->valid = false;
-            return;
-        }
-        memcpy(new_header, header,
-               header->len * header->value_size + sizeof(vec_header));
-        allocator_dealloc(new_header->_allocator, header);
-
-        *header_ptr = new_header;
+    // Reallocate, in place if the allocator can.
+    vec_header *new_header = allocator_realloc(
+        header->_allocator, header,
+        vec_alloc_size(header->capacity, header->value_size),
+        vec_alloc_size(capacity, header->value_size));
+    if (new_header == NULL) {
+        header->valid = false;
+        return;
     }
+    new_header->capacity = capacity;
+
+    *header_ptr = new_header;
 }
 
 void vec_resize(void *vec_ptr, size_t len) {
     void **vec_addr = vec_ptr;
     vec_header *header = get_vec_header(*vec_addr);
     if (header->capacity < len) {
-        vec_grow_capacity(&header, len - header->capacity);
+        vec_grow_capacity(&header, len - header->len);
         if (!header->valid) {
             return;
         }
@@ -134,7 +120,7 @@ void vec_sort(void *vec, vec_less_f less) {
 /* TODO: implement a quicksort and a stable sort. */
 void vec_sort_ctx(void *vec, vec_less_ctx_f less, void *ctx) {
     vec_header *header = get_vec_header(vec);
-    for (size_t i = 0; i < header->len - 1; ++i) {
+    for (size_t i = 0; i + 1 < header->len; ++i) {
         for (size_t j = i + 1; j < header->len; ++j) {
             if (less(vec, j, i, ctx)) {
                 vec_swap(vec, j, i);
@@ -0,0 +1,24 @@
+#ifndef DELTA_SRC_VEC_HEADER_H_
+#define DELTA_SRC_VEC_HEADER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "delta/allocator.h"
+
+// Header stored in front of the data of every vec. It is private to the
+// library: vec.c manages it, and vec_mapped.c stores it in a mapped file.
+typedef struct vec_header {
+    size_t value_size;
+    size_t len;
+    size_t capacity;
+    bool valid;
+    char _[7];
+
+    const allocator_t *_allocator;
+} vec_header;
+
+#define get_vec_header(vec) (((vec_header *)vec) - 1)
+#define get_vec_header_const(vec) (((const vec_header *)vec) - 1)
+
+#endif  // DELTA_SRC_VEC_HEADER_H_
@@ -0,0 +1,550 @@
+#include "delta/vec_kernels.h"
+
+#include <stdint.h>
+
+#include "delta/vec.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define DELTA_VEC_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+/* Scalar kernels. They are used on non-x86 targets and for the tails of the
+ * vectorized kernels. The search kernels start at index i. */
+
+#define DEFINE_SCALAR_KERNELS(suffix, T)                                     \
+    static size_t find_##suffix##_scalar(const T* v, size_t i, size_t len,  \
+                                         T x) {                             \
+        for (; i < len; ++i) {                                              \
+            if (v[i] == x) {                                                \
+                return i;                                                   \
+            }                                                               \
+        }                                                                   \
+        return SIZE_MAX;                                                    \
+    }                                                                       \
+                                                                            \
+    static size_t count_eq_##suffix##_scalar(const T* v, size_t i,          \
+                                             size_t len, T x) {             \
+        size_t n = 0;                                                       \
+        for (; i < len; ++i) {                                              \
+            n += v[i] == x;                                                 \
+        }                                                                   \
+        return n;                                                           \
+    }
+
+#define DEFINE_SCALAR_REDUCTIONS(suffix, T, S)                               \
+    static void minmax_##suffix##_scalar(const T* v, size_t i, size_t len,  \
+                                         T* min, T* max) {                  \
+        for (; i < len; ++i) {                                              \
+            if (v[i] < *min) {                                              \
+                *min = v[i];                                                \
+            }                                                               \
+            if (v[i] > *max) {                                              \
+                *max = v[i];                                                \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    static S sum_##suffix##_scalar(const T* v, size_t i, size_t len) {      \
+        S sum = 0;                                                          \
+        for (; i < len; ++i) {                                              \
+            sum += v[i];                                                    \
+        }                                                                   \
+        return sum;                                                         \
+    }
+
+DEFINE_SCALAR_KERNELS(u8, uint8_t)
+DEFINE_SCALAR_KERNELS(u32, uint32_t)
+DEFINE_SCALAR_KERNELS(u64, uint64_t)
+DEFINE_SCALAR_REDUCTIONS(u8, uint8_t, uint64_t)
+DEFINE_SCALAR_REDUCTIONS(u32, uint32_t, uint64_t)
+DEFINE_SCALAR_REDUCTIONS(u64, uint64_t, uint64_t)
+DEFINE_SCALAR_REDUCTIONS(f64, double, double)
+
+#ifdef DELTA_VEC_KERNELS_X86
+
+#define AVX2 __attribute__((target("avx2,popcnt")))
+
+static bool has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+
+/* SSE2 lacks a 64-bit equality comparison, so it is made of two 32-bit ones. */
+static __m128i cmpeq_epi64_sse2(__m128i a, __m128i b) {
+    const __m128i eq = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+static __m128i set1_u8_sse2(uint8_t x) { return _mm_set1_epi8((char)x); }
+static __m128i set1_u32_sse2(uint32_t x) { return _mm_set1_epi32((int)x); }
+static __m128i set1_u64_sse2(uint64_t x) {
+    return _mm_set1_epi64x((long long)x);
+}
+
+AVX2 static __m256i set1_u8_avx2(uint8_t x) {
+    return _mm256_set1_epi8((char)x);
+}
+AVX2 static __m256i set1_u32_avx2(uint32_t x) {
+    return _mm256_set1_epi32((int)x);
+}
+AVX2 static __m256i set1_u64_avx2(uint64_t x) {
+    return _mm256_set1_epi64x((long long)x);
+}
+
+/* The search kernels compare one vector of elements at a time and turn the
+ * comparison into a byte mask, so the index of the first match is the number
+ * of trailing zeros of the mask divided by the element size. The AVX2 kernels
+ * test two vectors per iteration to keep enough loads in flight to saturate
+ * the memory bandwidth. */
+
+#define DEFINE_SSE2_SEARCH(suffix, T, cmpeq)                                 \
+    static size_t find_##suffix##_sse2(const T* v, size_t len, T x) {       \
+        const __m128i needle = set1_##suffix##_sse2(x);                     \
+        const size_t step = 16 / sizeof(T);                                 \
+        size_t i = 0;                                                       \
+        for (; i + step <= len; i += step) {                                \
+            const __m128i a = _mm_loadu_si128((const __m128i*)(v + i));     \
+            const unsigned mask =                                           \
+                (unsigned)_mm_movemask_epi8(cmpeq(a, needle));              \
+            if (mask != 0) {                                                \
+                return i + (size_t)__builtin_ctz(mask) / sizeof(T);         \
+            }                                                               \
+        }                                                                   \
+        return find_##suffix##_scalar(v, i, len, x);                        \
+    }                                                                       \
+                                                                            \
+    static size_t count_eq_##suffix##_sse2(const T* v, size_t len, T x) {   \
+        const __m128i needle = set1_##suffix##_sse2(x);                     \
+        const size_t step = 16 / sizeof(T);                                 \
+        size_t n = 0;                                                       \
+        size_t i = 0;                                                       \
+        for (; i + step <= len; i += step) {                                \
+            const __m128i a = _mm_loadu_si128((const __m128i*)(v + i));     \
+            const unsigned mask =                                           \
+                (unsigned)_mm_movemask_epi8(cmpeq(a, needle));              \
+            n += (size_t)__builtin_popcount(mask);                          \
+        }                                                                   \
+        return n / sizeof(T) + count_eq_##suffix##_scalar(v, i, len, x);    \
+    }
+
+#define DEFINE_AVX2_SEARCH(suffix, T, cmpeq)                                 \
+    AVX2 static size_t find_##suffix##_avx2(const T* v, size_t len, T x) {  \
+        const __m256i needle = set1_##suffix##_avx2(x);                     \
+        const size_t step = 32 / sizeof(T);                                 \
+        size_t i = 0;                                                       \
+        for (; i + 2 * step <= len; i += 2 * step) {                        \
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(v + i));  \
+            const __m256i b =                                               \
+                _mm256_loadu_si256((const __m256i*)(v + i + step));         \
+            const __m256i ea = cmpeq(a, needle);                            \
+            const __m256i eb = cmpeq(b, needle);                            \
+            if (!_mm256_testz_si256(_mm256_or_si256(ea, eb),                \
+                                    _mm256_or_si256(ea, eb))) {             \
+                const uint64_t mask =                                       \
+                    (uint32_t)_mm256_movemask_epi8(ea) |                    \
+                    (uint64_t)(uint32_t)_mm256_movemask_epi8(eb) << 32;     \
+                return i + (size_t)__builtin_ctzll(mask) / sizeof(T);       \
+            }                                                               \
+        }                                                                   \
+        return find_##suffix##_scalar(v, i, len, x);                        \
+    }                                                                       \
+                                                                            \
+    AVX2 static size_t count_eq_##suffix##_avx2(const T* v, size_t len,     \
+                                                T x) {                      \
+        const __m256i needle = set1_##suffix##_avx2(x);                     \
+        const size_t step = 32 / sizeof(T);                                 \
+        size_t n = 0;                                                       \
+        size_t i = 0;                                                       \
+        for (; i + step <= len; i += step) {                                \
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(v + i));  \
+            const unsigned mask =                                           \
+                (unsigned)_mm256_movemask_epi8(cmpeq(a, needle));           \
+            n += (size_t)__builtin_popcount(mask);                          \
+        }                                                                   \
+        return n / sizeof(T) + count_eq_##suffix##_scalar(v, i, len, x);    \
+    }
+
+DEFINE_SSE2_SEARCH(u8, uint8_t, _mm_cmpeq_epi8)
+DEFINE_SSE2_SEARCH(u32, uint32_t, _mm_cmpeq_epi32)
+DEFINE_SSE2_SEARCH(u64, uint64_t, cmpeq_epi64_sse2)
+DEFINE_AVX2_SEARCH(u8, uint8_t, _mm256_cmpeq_epi8)
+DEFINE_AVX2_SEARCH(u32, uint32_t, _mm256_cmpeq_epi32)
+DEFINE_AVX2_SEARCH(u64, uint64_t, _mm256_cmpeq_epi64)
+
+/* Min/max kernels. Each lane keeps its own running min and max, and the lanes
+ * are reduced with the scalar kernel at the end. */
+
+static void minmax_u8_sse2(const uint8_t* v, size_t len, uint8_t* min,
+                           uint8_t* max) {
+    size_t i = 0;
+    if (len >= 16) {
+        __m128i lo = _mm_loadu_si128((const __m128i*)v);
+        __m128i hi = lo;
+        for (i = 16; i + 16 <= len; i += 16) {
+            const __m128i a = _mm_loadu_si128((const __m128i*)(v + i));
+            lo = _mm_min_epu8(lo, a);
+            hi = _mm_max_epu8(hi, a);
+        }
+        uint8_t los[16], his[16];
+        _mm_storeu_si128((__m128i*)los, lo);
+        _mm_storeu_si128((__m128i*)his, hi);
+        minmax_u8_scalar(los, 0, 16, min, max);
+        minmax_u8_scalar(his, 0, 16, min, max);
+    }
+    minmax_u8_scalar(v, i, len, min, max);
+}
+
+/* SSE2 only has signed 32-bit comparisons: flipping the sign bit of both
+ * operands turns them into unsigned ones. */
+static void minmax_u32_sse2(const uint32_t* v, size_t len, uint32_t* min,
+                            uint32_t* max) {
+    size_t i = 0;
+    if (len >= 4) {
+        const __m128i sign = _mm_set1_epi32(INT32_MIN);
+        __m128i lo = _mm_xor_si128(_mm_loadu_si128((const __m128i*)v), sign);
+        __m128i hi = lo;
+        for (i = 4; i + 4 <= len; i += 4) {
+            const __m128i a =
+                _mm_xor_si128(_mm_loadu_si128((const __m128i*)(v + i)), sign);
+            const __m128i lt = _mm_cmplt_epi32(a, lo);
+            const __m128i gt = _mm_cmpgt_epi32(a, hi);
+            lo = _mm_or_si128(_mm_and_si128(lt, a), _mm_andnot_si128(lt, lo));
+            hi = _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, hi));
+        }
+        uint32_t los[4], his[4];
+        _mm_storeu_si128((__m128i*)los, _mm_xor_si128(lo, sign));
+        _mm_storeu_si128((__m128i*)his, _mm_xor_si128(hi, sign));
+        minmax_u32_scalar(los, 0, 4, min, max);
+        minmax_u32_scalar(his, 0, 4, min, max);
+    }
+    minmax_u32_scalar(v, i, len, min, max);
+}
+
+static void minmax_f64_sse2(const double* v, size_t len, double* min,
+                            double* max) {
+    size_t i = 0;
+    if (len >= 2) {
+        __m128d lo = _mm_loadu_pd(v);
+        __m128d hi = lo;
+        for (i = 2; i + 2 <= len; i += 2) {
+            const __m128d a = _mm_loadu_pd(v + i);
+            lo = _mm_min_pd(lo, a);
+            hi = _mm_max_pd(hi, a);
+        }
+        double los[2], his[2];
+        _mm_storeu_pd(los, lo);
+        _mm_storeu_pd(his, hi);
+        minmax_f64_scalar(los, 0, 2, min, max);
+        minmax_f64_scalar(his, 0, 2, min, max);
+    }
+    minmax_f64_scalar(v, i, len, min, max);
+}
+
+AVX2 static void minmax_u8_avx2(const uint8_t* v, size_t len, uint8_t* min,
+                                uint8_t* max) {
+    size_t i = 0;
+    if (len >= 32) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)v);
+        __m256i hi = lo;
+        for (i = 32; i + 32 <= len; i += 32) {
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(v + i));
+            lo = _mm256_min_epu8(lo, a);
+            hi = _mm256_max_epu8(hi, a);
+        }
+        uint8_t los[32], his[32];
+        _mm256_storeu_si256((__m256i*)los, lo);
+        _mm256_storeu_si256((__m256i*)his, hi);
+        minmax_u8_scalar(los, 0, 32, min, max);
+        minmax_u8_scalar(his, 0, 32, min, max);
+    }
+    minmax_u8_scalar(v, i, len, min, max);
+}
+
+AVX2 static void minmax_u32_avx2(const uint32_t* v, size_t len,
+                                 uint32_t* min, uint32_t* max) {
+    size_t i = 0;
+    if (len >= 8) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)v);
+        __m256i hi = lo;
+        for (i = 8; i + 8 <= len; i += 8) {
+            const __m256i a = _mm256_loadu_si256((const __m256i*)(v + i));
+            lo = _mm256_min_epu32(lo, a);
+            hi = _mm256_max_epu32(hi, a);
+        }
+        uint32_t los[8], his[8];
+        _mm256_storeu_si256((__m256i*)los, lo);
+        _mm256_storeu_si256((__m256i*)his, hi);
+        minmax_u32_scalar(los, 0, 8, min, max);
+        minmax_u32_scalar(his, 0, 8, min, max);
+    }
+    minmax_u32_scalar(v, i, len, min, max);
+}
+
+/* AVX2 has no 64-bit min/max, so the lanes are selected with a signed
+ * comparison on sign-flipped operands. */
+AVX2 static void minmax_u64_avx2(const uint64_t* v, size_t len,
+                                 uint64_t* min, uint64_t* max) {
+    size_t i = 0;
+    if (len >= 4) {
+        const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+        __m256i lo =
+            _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)v), sign);
+        __m256i hi = lo;
+        for (i = 4; i + 4 <= len; i += 4) {
+            const __m256i a = _mm256_xor_si256(
+                _mm256_loadu_si256((const __m256i*)(v + i)), sign);
+            lo = _mm256_blendv_epi8(lo, a, _mm256_cmpgt_epi64(lo, a));
+            hi = _mm256_blendv_epi8(hi, a, _mm256_cmpgt_epi64(a, hi));
+        }
+        uint64_t los[4], his[4];
+        _mm256_storeu_si256((__m256i*)los, _mm256_xor_si256(lo, sign));
+        _mm256_storeu_si256((__m256i*)his, _mm256_xor_si256(hi, sign));
+        minmax_u64_scalar(los, 0, 4, min, max);
+        minmax_u64_scalar(his, 0, 4, min, max);
+    }
+    minmax_u64_scalar(v, i, len, min, max);
+}
+
+AVX2 static void minmax_f64_avx2(const double* v, size_t len, double* min,
+                                 double* max) {
+    size_t i = 0;
+    if (len >= 4) {
+        __m256d lo = _mm256_loadu_pd(v);
+        __m256d hi = lo;
+        for (i = 4; i + 4 <= len; i += 4) {
+            const __m256d a = _mm256_loadu_pd(v + i);
+            lo = _mm256_min_pd(lo, a);
+            hi = _mm256_max_pd(hi, a);
+        }
+        double los[4], his[4];
+        _mm256_storeu_pd(los, lo);
+        _mm256_storeu_pd(his, hi);
+        minmax_f64_scalar(los, 0, 4, min, max);
+        minmax_f64_scalar(his, 0, 4, min, max);
+    }
+    minmax_f64_scalar(v, i, len, min, max);
+}
+
+/* Sum kernels. Integers are widened to 64-bit lanes before being added: bytes
+ * with a sum of absolute differences against zero, 32-bit integers by
+ * interleaving them with zeros. */
+
+static uint64_t sum_u8_sse2(const uint8_t* v, size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(v + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(a, zero));
+    }
+    uint64_t sums[2];
+    _mm_storeu_si128((__m128i*)sums, acc);
+    return sums[0] + sums[1] + sum_u8_scalar(v, i, len);
+}
+
+static uint64_t sum_u32_sse2(const uint32_t* v, size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(v + i));
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(a, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(a, zero));
+    }
+    uint64_t sums[2];
+    _mm_storeu_si128((__m128i*)sums, acc);
+    return sums[0] + sums[1] + sum_u32_scalar(v, i, len);
+}
+
+static uint64_t sum_u64_sse2(const uint64_t* v, size_t len) {
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 2 <= len; i += 2) {
+        acc = _mm_add_epi64(acc, _mm_loadu_si128((const __m128i*)(v + i)));
+    }
+    uint64_t sums[2];
+    _mm_storeu_si128((__m128i*)sums, acc);
+    return sums[0] + sums[1] + sum_u64_scalar(v, i, len);
+}
+
+static double sum_f64_sse2(const double* v, size_t len) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(v + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(v + i + 2));
+    }
+    double sums[2];
+    _mm_storeu_pd(sums, _mm_add_pd(acc0, acc1));
+    return sums[0] + sums[1] + sum_f64_scalar(v, i, len);
+}
+
+AVX2 static uint64_t sum_u8_avx2(const uint8_t* v, size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(v + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(a, zero));
+    }
+    uint64_t sums[4];
+    _mm256_storeu_si256((__m256i*)sums, acc);
+    return sums[0] + sums[1] + sums[2] + sums[3] + sum_u8_scalar(v, i, len);
+}
+
+AVX2 static uint64_t sum_u32_avx2(const uint32_t* v, size_t len) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        const __m128i lo = _mm_loadu_si128((const __m128i*)(v + i));
+        const __m128i hi = _mm_loadu_si128((const __m128i*)(v + i + 4));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(lo));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepu32_epi64(hi));
+    }
+    uint64_t sums[4];
+    _mm256_storeu_si256((__m256i*)sums, acc);
+    return sums[0] + sums[1] + sums[2] + sums[3] + sum_u32_scalar(v, i, len);
+}
+
+AVX2 static uint64_t sum_u64_avx2(const uint64_t* v, size_t len) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        acc = _mm256_add_epi64(acc,
+                               _mm256_loadu_si256((const __m256i*)(v + i)));
+    }
+    uint64_t sums[4];
+    _mm256_storeu_si256((__m256i*)sums, acc);
+    return sums[0] + sums[1] + sums[2] + sums[3] + sum_u64_scalar(v, i, len);
+}
+
+AVX2 static double sum_f64_avx2(const double* v, size_t len) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(v + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(v + i + 4));
+    }
+    double sums[4];
+    _mm256_storeu_pd(sums, _mm256_add_pd(acc0, acc1));
+    return sums[0] + sums[1] + sums[2] + sums[3] + sum_f64_scalar(v, i, len);
+}
+
+/* There is no SSE2 64-bit comparison, so the SSE2 level uses the scalar
+ * kernel. */
+static void minmax_u64_sse2(const uint64_t* v, size_t len, uint64_t* min,
+                            uint64_t* max) {
+    minmax_u64_scalar(v, 0, len, min, max);
+}
+
+/* Each kernel is called through a pointer to its AVX2 or SSE2 implementation,
+ * resolved by the first call, so that the CPU features are only looked up
+ * once. Threads racing on the first call resolve the same implementation. */
+
+#define DEFINE_RESOLVED(kernel, R, params, args)                       \
+    static R kernel##_resolve params;                                  \
+    static R(*kernel##_impl) params = kernel##_resolve;                \
+    static R kernel##_resolve params {                                 \
+        R(*impl) params = has_avx2() ? kernel##_avx2 : kernel##_sse2;  \
+        __atomic_store_n(&kernel##_impl, impl, __ATOMIC_RELAXED);      \
+        return impl args;                                              \
+    }
+
+#define DEFINE_RESOLVED_VOID(kernel, params, args)                        \
+    static void kernel##_resolve params;                                  \
+    static void (*kernel##_impl) params = kernel##_resolve;               \
+    static void kernel##_resolve params {                                 \
+        void (*impl) params = has_avx2() ? kernel##_avx2 : kernel##_sse2; \
+        __atomic_store_n(&kernel##_impl, impl, __ATOMIC_RELAXED);         \
+        impl args;                                                        \
+    }
+
+#define DEFINE_RESOLVED_SEARCH(suffix, T)                                 \
+    DEFINE_RESOLVED(find_##suffix, size_t, (const T* v, size_t len, T x), \
+                    (v, len, x))                                          \
+    DEFINE_RESOLVED(count_eq_##suffix, size_t,                            \
+                    (const T* v, size_t len, T x), (v, len, x))
+
+#define DEFINE_RESOLVED_REDUCTIONS(suffix, T, S)                       \
+    DEFINE_RESOLVED_VOID(minmax_##suffix,                              \
+                         (const T* v, size_t len, T* min, T* max),     \
+                         (v, len, min, max))                           \
+    DEFINE_RESOLVED(sum_##suffix, S, (const T* v, size_t len), (v, len))
+
+DEFINE_RESOLVED_SEARCH(u8, uint8_t)
+DEFINE_RESOLVED_SEARCH(u32, uint32_t)
+DEFINE_RESOLVED_SEARCH(u64, uint64_t)
+DEFINE_RESOLVED_REDUCTIONS(u8, uint8_t, uint64_t)
+DEFINE_RESOLVED_REDUCTIONS(u32, uint32_t, uint64_t)
+DEFINE_RESOLVED_REDUCTIONS(u64, uint64_t, uint64_t)
+DEFINE_RESOLVED_REDUCTIONS(f64, double, double)
+
+#define DISPATCH(kernel, ...) \
+    __atomic_load_n(&kernel##_impl, __ATOMIC_RELAXED)(__VA_ARGS__)
+
+#else
+
+#define DISPATCH_SCALAR_SEARCH(suffix, T)                                 \
+    static size_t find_##suffix##_portable(const T* v, size_t len, T x) { \
+        return find_##suffix##_scalar(v, 0, len, x);                      \
+    }                                                                     \
+    static size_t count_eq_##suffix##_portable(const T* v, size_t len,    \
+                                               T x) {                     \
+        return count_eq_##suffix##_scalar(v, 0, len, x);                  \
+    }
+
+#define DISPATCH_SCALAR_REDUCTIONS(suffix, T, S)                           \
+    static void minmax_##suffix##_portable(const T* v, size_t len, T* min, \
+                                           T* max) {                       \
+        minmax_##suffix##_scalar(v, 0, len, min, max);                     \
+    }                                                                      \
+    static S sum_##suffix##_portable(const T* v, size_t len) {             \
+        return sum_##suffix##_scalar(v, 0, len);                           \
+    }
+
+DISPATCH_SCALAR_SEARCH(u8, uint8_t)
+DISPATCH_SCALAR_SEARCH(u32, uint32_t)
+DISPATCH_SCALAR_SEARCH(u64, uint64_t)
+DISPATCH_SCALAR_REDUCTIONS(u8, uint8_t, uint64_t)
+DISPATCH_SCALAR_REDUCTIONS(u32, uint32_t, uint64_t)
+DISPATCH_SCALAR_REDUCTIONS(u64, uint64_t, uint64_t)
+DISPATCH_SCALAR_REDUCTIONS(f64, double, double)
+
+#define DISPATCH(kernel, ...) kernel##_portable(__VA_ARGS__)
+
+#endif /* DELTA_VEC_KERNELS_X86 */
+
+#define DEFINE_PUBLIC_SEARCH(suffix, T)                                \
+    size_t vec_find_##suffix(const T* vec, T value) {                  \
+        return DISPATCH(find_##suffix, vec, vec_len(vec), value);      \
+    }                                                                  \
+                                                                       \
+    size_t vec_count_eq_##suffix(const T* vec, T value) {              \
+        return DISPATCH(count_eq_##suffix, vec, vec_len(vec), value);  \
+    }
+
+#define DEFINE_PUBLIC_REDUCTIONS(suffix, T, S)                         \
+    bool vec_minmax_##suffix(const T* vec, T* min, T* max) {           \
+        const size_t len = vec_len(vec);                               \
+        if (len == 0) {                                                \
+            return false;                                              \
+        }                                                              \
+        T lo = vec[0];                                                 \
+        T hi = vec[0];                                                 \
+        DISPATCH(minmax_##suffix, vec, len, &lo, &hi);                 \
+        *min = lo;                                                     \
+        *max = hi;                                                     \
+        return true;                                                   \
+    }                                                                  \
+                                                                       \
+    S vec_sum_##suffix(const T* vec) {                                 \
+        return DISPATCH(sum_##suffix, vec, vec_len(vec));              \
+    }
+
+DEFINE_PUBLIC_SEARCH(u8, uint8_t)
+DEFINE_PUBLIC_SEARCH(u32, uint32_t)
+DEFINE_PUBLIC_SEARCH(u64, uint64_t)
+DEFINE_PUBLIC_REDUCTIONS(u8, uint8_t, uint64_t)
+DEFINE_PUBLIC_REDUCTIONS(u32, uint32_t, uint64_t)
+DEFINE_PUBLIC_REDUCTIONS(u64, uint64_t, uint64_t)
+DEFINE_PUBLIC_REDUCTIONS(f64, double, double)
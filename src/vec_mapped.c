@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+#include "delta/vec_mapped.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "delta/allocator.h"
+#include "vec_header.h"
+
+#define VEC_FILE_MAGIC "DELTAVEC"
+
+// Header of a mapped vec file. The vec header and the data follow it.
+typedef struct vec_file_header {
+    char magic[8];
+    // Size of the vec header, which depends on the architecture.
+    uint64_t header_size;
+} vec_file_header;
+
+// State of the mapping of a vec. Its allocator is stored in the vec header so
+// that vec_del unmaps the file.
+typedef struct vec_mapping {
+    allocator_t allocator;
+    int fd;
+    char *base;
+    size_t size;
+} vec_mapping;
+
+#define mapping_header(m) ((vec_header *)((m)->base + sizeof(vec_file_header)))
+
+static size_t mapping_size(size_t value_size, size_t capacity) {
+    return sizeof(vec_file_header) + sizeof(vec_header) +
+           (capacity + 1 /* swap buffer */) * value_size;
+}
+
+static void mapping_del(vec_mapping *m) {
+    if (m->base != NULL) {
+        munmap(m->base, m->size);
+    }
+    close(m->fd);
+    free(m);
+}
+
+// Mapped vecs are created by vec_make_mapped_impl and never allocate.
+static void *mapped_allocate(void *ctx, size_t size) {
+    (void)ctx;
+    (void)size;
+    return NULL;
+}
+
+static void mapped_deallocate(void *ctx, void *ptr) {
+    (void)ptr;
+    mapping_del(ctx);
+}
+
+// Grows or shrinks the file to hold the vec header and data of new_size bytes,
+// and remaps it. The address of the header is returned.
+static void *mapped_reallocate(void *ctx, void *ptr, size_t old_size,
+                               size_t new_size) {
+    vec_mapping *m = ctx;
+    const size_t size = sizeof(vec_file_header) + new_size;
+    (void)ptr;
+    (void)old_size;
+
+    if (ftruncate(m->fd, (off_t)size) != 0) {
+        return NULL;
+    }
+#ifdef MREMAP_MAYMOVE
+    // Linux can resize the mapping without unmapping the data.
+    char *base = mremap(m->base, m->size, size, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+#else
+    char *base =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m->fd, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    munmap(m->base, m->size);
+#endif
+    m->base = base;
+    m->size = size;
+
+    return mapping_header(m);
+}
+
+// Maps size bytes of the file. The file descriptor is owned by the returned
+// mapping, and is closed in case of error.
+static vec_mapping *mapping_make(int fd, size_t size) {
+    vec_mapping *m = malloc(sizeof(vec_mapping));
+    if (m == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    m->allocator.ctx = m;
+    m->allocator.allocate = mapped_allocate;
+    m->allocator.deallocate = mapped_deallocate;
+    m->allocator.reallocate = mapped_reallocate;
+    m->allocator.deallocate_sized = NULL;
+    m->fd = fd;
+    m->size = size;
+    m->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m->base == MAP_FAILED) {
+        m->base = NULL;
+        mapping_del(m);
+        return NULL;
+    }
+    return m;
+}
+
+void *vec_make_mapped_impl(size_t value_size, const char *path,
+                           size_t capacity) {
+    const size_t size = mapping_size(value_size, capacity);
+    const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    vec_mapping *m = mapping_make(fd, size);
+    if (m == NULL) {
+        return NULL;
+    }
+
+    vec_file_header *file_header = (vec_file_header *)m->base;
+    memcpy(file_header->magic, VEC_FILE_MAGIC, sizeof(file_header->magic));
+    file_header->header_size = sizeof(vec_header);
+
+    vec_header *s = mapping_header(m);
+    s->value_size = value_size;
+    s->len = 0;
+    s->capacity = capacity;
+    s->valid = true;
+    s->_allocator = &m->allocator;
+
+    return s + 1;
+}
+
+void *vec_open_mapped_impl(size_t value_size, const char *path) {
+    struct stat st;
+    const int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 ||
+        (size_t)st.st_size < mapping_size(value_size, 0)) {
+        close(fd);
+        return NULL;
+    }
+    vec_mapping *m = mapping_make(fd, (size_t)st.st_size);
+    if (m == NULL) {
+        return NULL;
+    }
+
+    // The mapping is lazy, so checking the headers only reads the first page.
+    const vec_file_header *file_header = (const vec_file_header *)m->base;
+    vec_header *s = mapping_header(m);
+    if (memcmp(file_header->magic, VEC_FILE_MAGIC,
+               sizeof(file_header->magic)) != 0 ||
+        file_header->header_size != sizeof(vec_header) ||
+        s->value_size != value_size || s->len > s->capacity ||
+        mapping_size(value_size, s->capacity) > m->size) {
+        mapping_del(m);
+        return NULL;
+    }
+
+    // The allocator stored in the file belongs to the process which wrote it.
+    s->_allocator = &m->allocator;
+
+    return s + 1;
+}
+
+bool vec_sync_mapped(const void *vec) {
+    const vec_header *header = get_vec_header_const(vec);
+    if (header->_allocator->deallocate != mapped_deallocate) {
+        return false;
+    }
+    const vec_mapping *m = header->_allocator->ctx;
+    return msync(m->base, m->size, MS_SYNC) == 0;
+}
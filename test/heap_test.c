@@ -0,0 +1,88 @@
+#undef NDEBUG
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "delta/heap.h"
+#include "delta/vec.h"
+
+#define NB_VALUES 1000
+
+static bool int_less(void* vec, size_t i, size_t j, void* ctx) {
+    (void)ctx;
+    const int* v = vec;
+    return v[i] < v[j];
+}
+
+// Returns NB_VALUES pseudo-random values, with duplicates.
+static int* make_values(void) {
+    int* values = vec_make(int, 0, NB_VALUES);
+    uint32_t x = 42;
+    for (size_t i = 0; i < NB_VALUES; ++i) {
+        x = x * 1664525 + 1013904223;
+        vec_append(&values, (int)(x >> 22));
+    }
+    assert(vec_valid(values));
+    return values;
+}
+
+// Pops the heap, checking that its elements come in increasing order, and
+// returns them in a new vec.
+static int* pop_all(int** heap, size_t d) {
+    int* sorted = vec_make(int, 0, vec_len(*heap));
+    while (vec_len(*heap) > 0) {
+        const int top = heap_peek(*heap);
+        dheap_pop(heap, d, int_less, NULL);
+        assert((*heap)[vec_len(*heap)] == top);
+        assert(vec_len(sorted) == 0 || sorted[vec_len(sorted) - 1] <= top);
+        vec_append(&sorted, top);
+    }
+    assert(vec_valid(sorted));
+    return sorted;
+}
+
+// Returns the values pushed on a heap of arity d then popped.
+static int* push_pop(const int* values, size_t d) {
+    int* heap = vec_make(int, 0, 0);
+    for (size_t i = 0; i < vec_len(values); ++i) {
+        dheap_push(&heap, d, values[i], int_less, NULL);
+    }
+    assert(vec_valid(heap));
+    int* sorted = pop_all(&heap, d);
+    vec_del(heap);
+    return sorted;
+}
+
+// Returns the values heapified with arity d then popped.
+static int* heapify_pop(const int* values, size_t d) {
+    int* heap = vec_make(int, 0, vec_len(values));
+    for (size_t i = 0; i < vec_len(values); ++i) {
+        vec_append(&heap, values[i]);
+    }
+    dheap_heapify(heap, d, int_less, NULL);
+    int* sorted = pop_all(&heap, d);
+    vec_del(heap);
+    return sorted;
+}
+
+// Binary and 4-ary heaps order the same input the same way.
+static void test_arity(void) {
+    int* values = make_values();
+    int* sorted[4] = {push_pop(values, 2), push_pop(values, 4),
+                      heapify_pop(values, 2), heapify_pop(values, 4)};
+    for (size_t s = 0; s < 4; ++s) {
+        assert(vec_len(sorted[s]) == NB_VALUES);
+        for (size_t i = 0; i < NB_VALUES; ++i) {
+            assert(sorted[s][i] == sorted[0][i]);
+        }
+    }
+    for (size_t s = 0; s < 4; ++s) {
+        vec_del(sorted[s]);
+    }
+    vec_del(values);
+}
+
+int main(void) {
+    test_arity();
+    return 0;
+}
@@ -0,0 +1,31 @@
+# Benchmark of qex at several scales, run by the qex_bench target: generates
+# an input of each of the comma-separated SIZES with QEX_GEN in DIR, unless it
+# already exists, and prints the stats of QEX on it in each of its modes.
+
+string(REPLACE "," ";" SIZES "${SIZES}")
+cmake_host_system_information(RESULT JOBS QUERY NUMBER_OF_LOGICAL_CORES)
+file(MAKE_DIRECTORY "${DIR}")
+
+foreach(size ${SIZES})
+  set(input "${DIR}/${size}.tsv")
+  if(NOT EXISTS "${input}")
+    message(STATUS "Generating ${input}")
+    execute_process(COMMAND "${QEX_GEN}" -s ${size} -o "${input}"
+                    RESULT_VARIABLE result)
+    if(result)
+      file(REMOVE "${input}")
+      message(FATAL_ERROR "qex_gen failed: ${result}")
+    endif()
+  endif()
+
+  foreach(mode "-n;10" "-s;-n;10" "-j;${JOBS};-n;10" "index;-o;${DIR}/index")
+    string(REPLACE ";" " " name "${mode}")
+    execute_process(COMMAND "${QEX}" ${mode} --stats "${input}"
+                    OUTPUT_QUIET ERROR_VARIABLE stats RESULT_VARIABLE result)
+    if(result)
+      message(FATAL_ERROR "qex ${name} failed on ${input}: ${result}")
+    endif()
+    message("qex ${name} ${size}.tsv\n${stats}")
+  endforeach()
+endforeach()
+file(REMOVE "${DIR}/index")
@@ -0,0 +1,99 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Client of `qex serve`: sends each request given in argument, or each line of
+ * the standard input if there is none, and prints the responses.
+ */
+
+static void print_usage(void) {
+    fprintf(stderr, "usage: qex_client SOCKET [REQUEST ...]\n");
+}
+
+/* Returns a stream connected to the Unix domain socket at path, or NULL in
+ * case of error. */
+static FILE* connect_to(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    FILE* f = NULL;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        (f = fdopen(fd, "r+")) == NULL) {
+        close(fd);
+        return NULL;
+    }
+    return f;
+}
+
+/* Sends the request and prints its response, up to the empty line ending it.
+ * Returns 0 if the connection is lost. */
+static int request(FILE* f, const char* req, size_t size, char** line,
+                   size_t* line_size) {
+    if (fwrite(req, 1, size, f) != size || fputc('\n', f) == EOF ||
+        fflush(f) != 0) {
+        return 0;
+    }
+    while (1) {
+        const ssize_t n = getline(line, line_size, f);
+        if (n <= 0) {
+            return 0;
+        }
+        if (n == 1 && (*line)[0] == '\n') {
+            return 1;
+        }
+        fwrite(*line, 1, (size_t)n, stdout);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || 0 == strcmp("-h", argv[1])) {
+        print_usage();
+        return argc < 2;
+    }
+    FILE* f = connect_to(argv[1]);
+    if (f == NULL) {
+        fprintf(stderr, "error: failed to connect to %s\n", argv[1]);
+        return 1;
+    }
+
+    char* line = NULL;
+    size_t line_size = 0;
+    int ok = 1;
+    if (argc > 2) {
+        for (int i = 2; ok && i < argc; ++i) {
+            ok = request(f, argv[i], strlen(argv[i]), &line, &line_size);
+        }
+    } else {
+        char* req = NULL;
+        size_t req_size = 0;
+        ssize_t n;
+        while (ok && (n = getline(&req, &req_size, stdin)) > 0) {
+            if (req[n - 1] == '\n') {
+                --n;
+            }
+            ok = request(f, req, (size_t)n, &line, &line_size);
+        }
+        free(req);
+    }
+    free(line);
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "error: connection lost\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Generator of synthetic qex inputs: TSV lines of a timestamp and a query,
+ * whose timestamps span a given number of seconds in increasing order and
+ * whose queries follow a Zipf distribution over a given number of distinct
+ * queries. The same options always generate the same lines.
+ */
+
+/* First timestamp of the generated lines, 2015-08-01 00:00:00 UTC. */
+#define GEN_START 1438387200
+
+/* Size of the output buffer. */
+#define GEN_BUFFER_SIZE (1 << 20)
+
+typedef struct gen_args {
+    unsigned long long size;
+    /**< Number of bytes to write, the last line excepted */
+    unsigned long long span;
+    /**< Number of seconds spanned by the timestamps */
+    unsigned long long cardinality;
+    /**< Number of distinct queries */
+    double skew;
+    /**< Exponent of the Zipf distribution, 0 for uniform queries */
+    unsigned long long seed;
+    const char* output;
+} gen_args_t;
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: qex_gen [-s SIZE] [-t SPAN] [-c CARDINALITY] [-z SKEW]\n"
+            "               [-r SEED] [-o FILE]\n\n"
+            "  -s SIZE         Bytes to write, with an optional K, M or G\n"
+            "                  suffix, 100M by default.\n"
+            "  -t SPAN         Seconds spanned by the timestamps, from\n"
+            "                  2015-08-01 00:00:00, 86400 by default.\n"
+            "  -c CARDINALITY  Number of distinct queries, 100000 by\n"
+            "                  default.\n"
+            "  -z SKEW         Exponent of the Zipf distribution of the\n"
+            "                  queries, 1 by default. 0 draws them\n"
+            "                  uniformly.\n"
+            "  -r SEED         Seed of the random queries, 42 by default.\n"
+            "  -o FILE         Output file, the standard output by\n"
+            "                  default.\n");
+}
+
+/* Parses a positive integer with an optional K, M or G suffix. Returns 0 if
+ * the string isn't one. */
+static unsigned long long parse_size(const char* s) {
+    char* end = NULL;
+    unsigned long long n = strtoull(s, &end, 10);
+    if (end == s || s[0] == '-') {
+        return 0;
+    }
+    const char* units = "KMG";
+    const char* unit = *end != 0 ? strchr(units, *end) : NULL;
+    if (unit != NULL) {
+        n <<= 10 * (unit - units + 1);
+        ++end;
+    }
+    return *end == 0 ? n : 0;
+}
+
+static gen_args_t parse_options(int argc, char** argv) {
+    gen_args_t args = {100 << 20, 86400, 100000, 1.0, 42, NULL};
+    for (int i = 1; i < argc; ++i) {
+        const char* option = argv[i];
+        if (0 == strcmp("-h", option)) {
+            usage();
+            exit(0);
+        }
+        if (option[0] != '-' || option[1] == 0 || option[2] != 0 ||
+            strchr("stczro", option[1]) == NULL) {
+            fprintf(stderr, "error: unknown option %s\n", option);
+            usage();
+            exit(1);
+        }
+        if (++i == argc) {
+            fprintf(stderr, "error: %s option requires an argument\n", option);
+            exit(1);
+        }
+        const char* value = argv[i];
+        unsigned long long n = 1;
+        switch (option[1]) {
+            case 's':
+                n = args.size = parse_size(value);
+                break;
+            case 't':
+                n = args.span = parse_size(value);
+                break;
+            case 'c':
+                n = args.cardinality = parse_size(value);
+                break;
+            case 'z':
+                args.skew = atof(value);
+                n = args.skew >= 0;
+                break;
+            case 'r':
+                args.seed = strtoull(value, NULL, 10);
+                break;
+            case 'o':
+                args.output = value;
+                break;
+        }
+        if (n == 0) {
+            fprintf(stderr, "error: invalid %s argument %s\n", option, value);
+            exit(1);
+        }
+    }
+    return args;
+}
+
+/* Bijective mix of x, so that distinct seeds draw distinct sequences. */
+static uint64_t splitmix(uint64_t x) {
+    uint64_t z = x + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Returns the cumulative distribution of the ranks of the queries, or NULL in
+ * case of error. */
+static double* make_cdf(unsigned long long cardinality, double skew) {
+    double* cdf = malloc(cardinality * sizeof(double));
+    if (cdf == NULL) {
+        return NULL;
+    }
+    double sum = 0;
+    for (unsigned long long r = 0; r < cardinality; ++r) {
+        sum += pow((double)(r + 1), -skew);
+        cdf[r] = sum;
+    }
+    for (unsigned long long r = 0; r < cardinality; ++r) {
+        cdf[r] /= sum;
+    }
+    return cdf;
+}
+
+/* Returns the rank of the query of probability u in [0, 1[. */
+static unsigned long long draw_rank(const double* cdf,
+                                    unsigned long long cardinality, double u) {
+    unsigned long long lo = 0, hi = cardinality - 1;
+    while (lo < hi) {
+        const unsigned long long mid = lo + (hi - lo) / 2;
+        if (cdf[mid] <= u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Writes the query of the given rank to out and returns its length. Its first
+ * word spells the rank in base 26, so that queries of distinct ranks differ,
+ * and is followed by up to 3 random words. */
+static size_t write_query(char* out, unsigned long long rank, uint64_t seed) {
+    size_t len = 0;
+    do {
+        out[len++] = (char)('a' + rank % 26);
+        rank /= 26;
+    } while (rank > 0);
+
+    uint64_t h = splitmix(seed);
+    const unsigned nb_words = h & 3;
+    h >>= 2;
+    for (unsigned w = 0; w < nb_words; ++w) {
+        const unsigned word_len = 2 + (unsigned)(h % 8);
+        out[len++] = ' ';
+        for (unsigned c = 0; c < word_len; ++c) {
+            h = splitmix(h);
+            out[len++] = (char)('a' + h % 26);
+        }
+    }
+    return len;
+}
+
+int main(int argc, char** argv) {
+    const gen_args_t args = parse_options(argc, argv);
+    FILE* out = args.output != NULL ? fopen(args.output, "w") : stdout;
+    double* cdf = make_cdf(args.cardinality, args.skew);
+    if (out == NULL || cdf == NULL) {
+        fprintf(stderr, "error: failed to open %s\n",
+                out == NULL ? args.output : "memory");
+        return 1;
+    }
+    setvbuf(out, NULL, _IOFBF, GEN_BUFFER_SIZE);
+
+    /* the timestamp of a line grows with the bytes written before it */
+    char line[256];
+    char date[32] = "";
+    time_t second = -1;
+    uint64_t state = args.seed;
+    unsigned long long written = 0;
+    while (written < args.size) {
+        const time_t t =
+            GEN_START + (time_t)((double)written / (double)args.size *
+                                 (double)args.span);
+        if (t != second) {
+            struct tm tm;
+            gmtime_r(&t, &tm);
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S\t", &tm);
+            second = t;
+        }
+        size_t len = strlen(date);
+        memcpy(line, date, len);
+
+        state = splitmix(state);
+        const double u = (double)(state >> 11) / (double)(1ULL << 53);
+        const unsigned long long rank =
+            draw_rank(cdf, args.cardinality, u);
+        len += write_query(line + len, rank, rank ^ args.seed);
+        line[len++] = '\n';
+        if (fwrite(line, 1, len, out) != len) {
+            break;
+        }
+        written += len;
+    }
+
+    free(cdf);
+    if (fclose(out) != 0 || written < args.size) {
+        fprintf(stderr, "error: failed to write\n");
+        return 1;
+    }
+    return 0;
+}
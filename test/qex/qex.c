@@ -1,25 +1,112 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "delta/hash.h"
+#include "delta/heap.h"
 #include "delta/strmap.h"
+#include "delta/strset.h"
 #include "delta/vec.h"
+#include "reader.h"
+#include "scan.h"
+#include "serve.h"
+#include "sketch.h"
+#include "stats.h"
+#include "store.h"
+
+/* Size of the chunks read by the streaming mode. */
+#define QEX_CHUNK_SIZE (1 << 20)
+
+/* Number of chunks the streaming mode reads ahead while one is indexed. */
+#define QEX_READ_AHEAD 8
+
+/* Least delay between two refreshes of the follow mode, in milliseconds. */
+#define QEX_FOLLOW_INTERVAL 1000
+
+/* Most threads indexing the files: each thread keeps a shard of the queries
+ * per thread, so the memory of the shards grows with the square of their
+ * number. */
+#define QEX_MAX_JOBS 256
+
+/* Seed of the hash sharding queries between threads. */
+#define QEX_SHARD_SEED 0xc70f6907UL
+
+/* Seed of the hash of the queries added to HyperLogLog sketches. */
+#define QEX_SKETCH_SEED 0x9e3779b9UL
+
+/* Default sizes of the sketches of the approximate mode. */
+#define QEX_DEFAULT_PRECISION 14
+#define QEX_DEFAULT_COUNTERS 1024
+
+/** Subcommands of qex. */
+typedef enum command {
+    /* Count the queries of the input TSV files. */
+    COMMAND_SCAN,
+    /* Write the persistent index of the input TSV files. */
+    COMMAND_INDEX,
+    /* Count the queries of a persistent index. */
+    COMMAND_QUERY,
+    /* Count the queries of the input TSV files on requests. */
+    COMMAND_SERVE,
+} command_t;
 
 /** Holds the inputs arguments. */
 typedef struct args {
+    command_t command;
     size_t help;
     /* Number of results to display. Value 0 behave as if -q were given and
      * the total number of queries is displayed. */
     size_t num;
     /* Date range. Pointer to the input argument or NULL if no range. */
     char* range;
+    /* Whether inputs are streamed by chunks instead of mapped in memory. */
+    size_t stream;
+    /* Whether inputs are followed as they grow. */
+    size_t follow;
+    /* Number of indexing threads. */
+    size_t jobs;
     /* Input file paths. */
     char** files;
+    /* Path of the index written by qex index. */
+    char* output;
+    /* Path of the socket qex serve listens on. */
+    char* socket;
+    /* Whether queries are summarized by fixed-size sketches. */
+    size_t approx;
+    /* Precision of the HyperLogLog sketch of the approximate mode. */
+    size_t precision;
+    /* Number of counters of the Space-Saving sketch of the approximate
+     * mode. */
+    size_t counters;
+    /* Whether the time and memory of each phase are printed. */
+    size_t stats;
+    /* Whether streamed inputs are read by a pool of threads instead of
+     * io_uring. */
+    size_t no_uring;
 } args_t;
 
 /** Print usage */
 static void usage() {
-    printf("Usage: qex [-h] [-r RANGE] [-n NUM] FILE [FILE ...]\n");
+    printf(
+        "Usage: qex [-h] [-s] [-f] [--stats] [-j JOBS] [-r RANGE] [-n NUM]\n"
+        "           FILE [FILE ...]\n"
+        "       qex --approx [-p PRECISION] [-k COUNTERS] [-s] [-f] [-j JOBS]\n"
+        "           [-r RANGE] [-n NUM] FILE [FILE ...]\n"
+        "       qex index [-s] [--stats] [-j JOBS] [-r RANGE] -o INDEX\n"
+        "           FILE [FILE ...]\n"
+        "       qex query [-r RANGE] [-n NUM] INDEX\n"
+        "       qex serve [-s] [--stats] [-j JOBS] [-r RANGE] -l SOCKET\n"
+        "           FILE [FILE ...]\n");
 }
 
 /** Print help */
@@ -37,11 +124,66 @@ static void help() {
         "Options:\n"
         "  FILE      input TSV (tab separated values) files.\n"
         "  -h        Display help and exit.\n"
+        "  -s        Stream input files by chunks instead of mapping them in\n"
+        "            memory, so that memory use only depends on the number\n"
+        "            of distinct queries. Suits files larger than RAM. The\n"
+        "            next chunks, of the same or the next files, are read\n"
+        "            with io_uring while a chunk is indexed.\n"
+        "  -f        Follow the input files as they grow: once indexed, the\n"
+        "            lines appended to them are indexed as they are written,\n"
+        "            and the results are printed again after `# UPDATE`, at\n"
+        "            most every second, until interrupted. A partial last\n"
+        "            line is indexed once complete, and a truncated file is\n"
+        "            indexed again from its start.\n"
+        "  -j JOBS   Number of threads indexing the files, from 1 to 256, 1\n"
+        "            by default. Each file is split in JOBS ranges indexed\n"
+        "            concurrently.\n"
         "  -r RANGE  Optional parameter specifying the date range from which\n"
-        "            queries are extracted.\n"
+        "            queries are extracted. RANGE is a date prefix such as\n"
+        "            `2015-08-01` or `2015-08-01 00:03`, whose fields may be\n"
+        "            `*` wildcards as in `2015-*-01`.\n"
         "  -n NUM    If present, extract the NUM most popular queries done\n"
         "            within input files, optionally in the parametered date\n"
-        "            range.\n");
+        "            range. Queries are sorted by decreasing count, and\n"
+        "            queries with the same count in alphabetical order.\n"
+        "  --approx  Estimate the results with fixed-size sketches instead of\n"
+        "            keeping every distinct query in memory. The number of\n"
+        "            distinct queries is followed by its relative standard\n"
+        "            error, and the count of each popular query by the most\n"
+        "            it may exceed the exact count by.\n"
+        "  -p PRECISION\n"
+        "            Precision of the HyperLogLog sketch estimating the\n"
+        "            number of distinct queries with --approx, from 4 to 18.\n"
+        "            It uses 2^PRECISION bytes per thread, 14 by default.\n"
+        "  -k COUNTERS\n"
+        "            Number of queries counted by the Space-Saving sketch\n"
+        "            finding the most popular queries with --approx, 1024 by\n"
+        "            default. Queries done more than 1/COUNTERS of the time\n"
+        "            are always found.\n"
+        "  --stats   Print to the standard error the wall time and the peak\n"
+        "            resident memory of each phase: read, index, compute and\n"
+        "            output, the input throughput in MB/s and lines/s of the\n"
+        "            index phase, and the hardware events of each phase,\n"
+        "            such as cycles and cache misses, where the counters are\n"
+        "            permitted.\n"
+        "            Mapped files are read by page faults while they are\n"
+        "            indexed, which the index phase then includes.\n"
+        "  --no-uring\n"
+        "            Read the streamed inputs with a pool of threads instead\n"
+        "            of io_uring, as where io_uring is unavailable.\n\n"
+        "Commands:\n"
+        "  index     Write an index of the input files to the INDEX file\n"
+        "            given with -o INDEX. It holds the number of times each\n"
+        "            query was done during each second.\n"
+        "  query     Extract the queries of an INDEX file as from the input\n"
+        "            files it was written from, without parsing them again.\n"
+        "  serve     Index the input files in memory as qex index, then\n"
+        "            answer requests on the Unix domain socket given with\n"
+        "            -l SOCKET until interrupted. Each request is a line:\n"
+        "              COUNT [RANGE]    number of distinct queries\n"
+        "              TOP NUM [RANGE]  NUM most popular queries\n"
+        "            and its response lines end with an empty line. Errors\n"
+        "            are responded with an `ERROR <message>` line.\n");
 }
 
 /**
@@ -54,8 +196,19 @@ static args_t parse_options(int argc, char** argv) {
 
     args.help = 0;
     args.range = NULL;
+    args.stream = 0;
+    args.follow = 0;
+    args.jobs = 1;
     args.num = 0;
     args.files = NULL;
+    args.output = NULL;
+    args.socket = NULL;
+    args.command = COMMAND_SCAN;
+    args.approx = 0;
+    args.precision = QEX_DEFAULT_PRECISION;
+    args.counters = QEX_DEFAULT_COUNTERS;
+    args.stats = 0;
+    args.no_uring = 0;
 
     if (argc == 1) {
         /* print usage and early exit */
@@ -63,10 +216,28 @@ static args_t parse_options(int argc, char** argv) {
         exit(1);
     }
 
-    for (int i = 1; i < argc; ++i) {
+    int i = 1;
+    if (0 == strcmp("index", argv[i])) {
+        args.command = COMMAND_INDEX;
+        ++i;
+    } else if (0 == strcmp("query", argv[i])) {
+        args.command = COMMAND_QUERY;
+        ++i;
+    } else if (0 == strcmp("serve", argv[i])) {
+        args.command = COMMAND_SERVE;
+        ++i;
+    }
+
+    for (; i < argc; ++i) {
         if (0 == strcmp("-h", argv[i])) {
             /* parse help option */
             args.help = 1;
+        } else if (0 == strcmp("-s", argv[i])) {
+            /* parse stream option */
+            args.stream = 1;
+        } else if (0 == strcmp("-f", argv[i])) {
+            /* parse follow option */
+            args.follow = 1;
         } else if (0 == strcmp("-r", argv[i])) {
             /* parse range option with a required argument */
             ++i;
@@ -78,6 +249,93 @@ static args_t parse_options(int argc, char** argv) {
             } else {
                 args.range = argv[i];
             }
+        } else if (0 == strcmp("--approx", argv[i])) {
+            /* parse approximate option */
+            args.approx = 1;
+        } else if (0 == strcmp("--stats", argv[i])) {
+            /* parse stats option */
+            args.stats = 1;
+        } else if (0 == strcmp("--no-uring", argv[i])) {
+            /* parse thread pool reads option */
+            args.no_uring = 1;
+        } else if (0 == strcmp("-p", argv[i]) ||
+                   0 == strcmp("-k", argv[i])) {
+            /* parse sketch size options with a required argument */
+            const char* option = argv[i++];
+            if (i == argc) {
+                fprintf(stderr,
+                        "error: %s option requires an argument. Use qex -h for "
+                        "details\n",
+                        option);
+                exit(1);
+            }
+            char* end = NULL;
+            const long long size = strtoll(argv[i], &end, 10);
+            if (option[1] == 'p' &&
+                (end == argv[i] || size < HLL_MIN_PRECISION ||
+                 size > HLL_MAX_PRECISION)) {
+                fprintf(stderr,
+                        "error: integer from %d to %d expected as argument of "
+                        "-p option\n",
+                        HLL_MIN_PRECISION, HLL_MAX_PRECISION);
+                exit(1);
+            }
+            if (option[1] == 'k' &&
+                (end == argv[i] || size < 1 ||
+                 (size_t)size > TOPK_MAX_COUNTERS)) {
+                fprintf(stderr,
+                        "error: integer from 1 to %zu expected as argument of "
+                        "-k option\n",
+                        TOPK_MAX_COUNTERS);
+                exit(1);
+            }
+            if (option[1] == 'p') {
+                args.precision = (size_t)size;
+            } else {
+                args.counters = (size_t)size;
+            }
+        } else if (0 == strcmp("-l", argv[i])) {
+            /* parse socket option with a required argument */
+            ++i;
+            if (i == argc) {
+                fprintf(stderr,
+                        "error: -l option requires an argument. Use qex -h for "
+                        "details\n");
+                exit(1);
+            } else {
+                args.socket = argv[i];
+            }
+        } else if (0 == strcmp("-o", argv[i])) {
+            /* parse output option with a required argument */
+            ++i;
+            if (i == argc) {
+                fprintf(stderr,
+                        "error: -o option requires an argument. Use qex -h for "
+                        "details\n");
+                exit(1);
+            } else {
+                args.output = argv[i];
+            }
+        } else if (0 == strcmp("-j", argv[i])) {
+            /* parse jobs option with a required argument */
+            ++i;
+            if (i == argc) {
+                fprintf(stderr,
+                        "error: -j option requires an argument. Use qex -h for "
+                        "details\n");
+                exit(1);
+            } else {
+                char* end = NULL;
+                const long long jobs = strtoll(argv[i], &end, 10);
+                if (end == argv[i] || jobs < 1 || jobs > QEX_MAX_JOBS) {
+                    fprintf(stderr,
+                            "error: integer from 1 to %d expected as argument "
+                            "of -j option\n",
+                            QEX_MAX_JOBS);
+                    exit(1);
+                }
+                args.jobs = (size_t)jobs;
+            }
         } else if (0 == strcmp("-n", argv[i])) {
             /* parse num option with a required argument */
             ++i;
@@ -113,22 +371,66 @@ static args_t parse_options(int argc, char** argv) {
         }
     }
 
+    if (args.help) {
+        return args;
+    }
+    if (args.command == COMMAND_INDEX && args.output == NULL) {
+        fprintf(stderr,
+                "error: qex index requires an -o INDEX option. Use qex -h for "
+                "details\n");
+        exit(1);
+    }
+    if (args.command == COMMAND_SERVE && args.socket == NULL) {
+        fprintf(stderr,
+                "error: qex serve requires an -l SOCKET option. Use qex -h for "
+                "details\n");
+        exit(1);
+    }
+    if (args.command != COMMAND_SCAN && args.approx) {
+        fprintf(stderr,
+                "error: --approx option only applies to input files. Use qex "
+                "-h for details\n");
+        exit(1);
+    }
+    if (args.command != COMMAND_SCAN && args.follow) {
+        fprintf(stderr,
+                "error: -f option only applies to qex without command. Use qex "
+                "-h for details\n");
+        exit(1);
+    }
+    if ((args.command == COMMAND_QUERY || args.follow) && args.stats) {
+        fprintf(stderr,
+                "error: --stats option only applies to input files read "
+                "once. Use qex -h for details\n");
+        exit(1);
+    }
+    if (args.command == COMMAND_QUERY && vec_len(args.files) != 1) {
+        fprintf(stderr,
+                "error: qex query requires a single INDEX file. Use qex -h "
+                "for details\n");
+        exit(1);
+    }
+
     return args;
 }
 
 typedef struct {
-    int year, month, day;
-    /* Second part of the timestamp */
-    int hour, minute, second;
-    char* end;
+    /* Year, month, day, hour, minute and second, or -1 for the fields which
+     * are not given or are wildcards. */
+    int date[6];
+    const char* end;
 } range_t;
 
-static int toint(char* s, char** next) {
+/* Widths in bits of the fields of a packed timestamp, from year to second. */
+static const unsigned packed_widths[6] = {16, 8, 8, 8, 8, 8};
+
+/* Parses the integer starting at s, without reading end and beyond. */
+static int toint(const char* s, const char* end, const char** next) {
     int result = 0;
 
-    while (s && (*s == ' ' || *s == '\t')) ++s;
+    while (s && s < end && (*s == ' ' || *s == '\t')) ++s;
 
-    for (; s && *s >= '0' && *s <= '9'; ++s) {
+    for (; s && s < end && *s >= '0' && *s <= '9'; ++s) {
         result *= 10;
         result += (*s - '0');
     }
@@ -140,25 +442,27 @@ static int toint(char* s, char** next) {
     return result;
 }
 
-static void parse_range(range_t* r, char* range) {
+/* Parses the range held by [range, end[, which doesn't need to be
+ * NUL-terminated. */
+static void parse_range(range_t* r, const char* range, const char* end) {
     /* fill a table of 6 dates with the string range. This loop accepts
      * wildcards characters (*) */
     int date[6] = {-1, -1, -1, -1, -1, -1};
-    char* next_token = NULL;
+    const char* next_token = NULL;
 
     for (size_t i = 0; range && i < 6; ++i) {
-        date[i] = toint(range, &next_token);
-        if (range == next_token && *range == '*') {
+        date[i] = toint(range, end, &next_token);
+        if (range == next_token && range < end && *range == '*') {
             /* skipping wildcard character '*' + '-' */
             date[i] = -1;
             range++;
-            if (*range != 0) range++;
+            if (range < end) range++;
         } else if (range == next_token) {
             /* invalid character found where integer conversion should occured.
              * reset current date value to -1 and stop conversion. */
             date[i] = -1;
             break;
-        } else if (*next_token == 0) {
+        } else if (next_token == end) {
             break;
         } else {
             /* eventually step over separator character such as '-', ' ', '\t'
@@ -169,141 +473,1215 @@ static void parse_range(range_t* r, char* range) {
 
     /* fill attributes */
     r->end = next_token;
-    r->year = date[0];
-    r->month = date[1];
-    r->day = date[2];
-    r->hour = date[3];
-    r->minute = date[4];
-    r->second = date[5];
+    memcpy(r->date, date, sizeof(date));
 }
 
-typedef struct qex {
-    range_t _user_range;
-    /**< User-defined range given as constructor's input argument */
+/* Packs the fields of the date, from year to second, into key from its most to
+ * its least significant bits. Returns 0 if a field doesn't fit its width. */
+static int pack_date(const int date[6], uint64_t* key) {
+    uint64_t k = 0;
+    int fits = 1;
+    for (size_t i = 0; i < 6; ++i) {
+        const uint64_t max = ((uint64_t)1 << packed_widths[i]) - 1;
+        fits &= date[i] >= 0 && (uint64_t)date[i] <= max;
+        k = (k << packed_widths[i]) | ((uint64_t)date[i] & max);
+    }
+    *key = k;
+    return fits;
+}
+
+/** A date range compiled into a predicate on dates. */
+typedef struct range_filter {
+    range_t range;
+    /**< Range parsed from the user input */
+    uint64_t mask;
+    uint64_t value;
+    /**< The packed timestamps in range are the keys such that
+     * (key & mask) == value */
+    int packed;
+    /**< Whether the fields of the range fit the packed timestamps */
+} range_filter_t;
+
+/* Parses the range, or the range of all dates if NULL, and compiles it into a
+ * mask selecting its given fields in packed timestamps. */
+static void range_filter_init(range_filter_t* f, const char* range) {
+    parse_range(&f->range, range, range != NULL ? range + strlen(range) : NULL);
+
+    f->mask = 0;
+    f->value = 0;
+    f->packed = 1;
+    for (size_t i = 0, shift = 56; i < 6; ++i) {
+        const int field = f->range.date[i];
+        const uint64_t max = ((uint64_t)1 << packed_widths[i]) - 1;
+        shift -= packed_widths[i];
+        if (field == -1) {
+            continue;
+        }
+        if (field < 0 || (uint64_t)field > max) {
+            f->packed = 0;
+        }
+        f->mask |= max << shift;
+        f->value |= ((uint64_t)field & max) << shift;
+    }
+}
+
+/* Returns whether the date is in the range: all the fields the range gives are
+ * equal. */
+static int range_filter_match(const range_filter_t* f, const int date[6]) {
+    uint64_t key = 0;
+    if (pack_date(date, &key) && f->packed) {
+        return (key & f->mask) == f->value;
+    }
+    /* compare the fields one by one when they don't fit packed timestamps */
+    for (size_t i = 0; i < 6; ++i) {
+        const int field = f->range.date[i];
+        if (field != -1 && field != date[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+typedef struct qex qex_t;
+
+/** State of an indexing thread. */
+typedef struct worker {
+    qex_t* q;
     range_t _range;
-    /**< Current range object being updated at each line parsing */
-    strmap_t _queries_in_range;
-    /**< Queries in requested range */
-    strmap_t _popular_queries;
-} qex_t;
+    /**< Timestamp of the line being parsed */
+    strmap_t* _shards;
+    /**< Queries in requested range indexed by this thread, sharded by hash */
+    char* _key;
+    /**< Buffer of the keys of the queries counted per second */
+    hll_t* _hll;
+    topk_t* _topk;
+    /**< Sketches of the queries in range in approximate mode */
+    const char* begin;
+    const char* end;
+    /**< Lines to index */
+    int delta;
+    /**< Added to the count of each indexed query */
+    int ok;
+    /**< Whether no invalid line stopped the indexing */
+    size_t lines;
+    /**< Number of lines indexed */
+    size_t shard;
+    /**< Shard merged by this thread */
+    pthread_t thread;
+} worker_t;
 
-static void qex_init(qex_t* q, char* range) {
+struct qex {
+    range_filter_t _filter;
+    /**< User-defined range given as constructor's input argument */
+    int _by_second;
+    /**< Whether queries are counted per second of their timestamp */
+    hll_t* _hll;
+    topk_t* _topk;
+    /**< Sketches of the queries in range in approximate mode, set by
+     * qex_init_approx */
+    size_t _nb_threads;
+    worker_t* _workers;
+    /**< Indexing threads, one per thread */
+    strmap_t* _queries_in_range;
+    /**< Queries in requested range, sharded by hash, set by qex_merge */
+    stats_t* _stats;
+    /**< Phases timed, or NULL if they aren't */
+};
+
+static void qex_init(qex_t* q, const char* range, size_t nb_threads,
+                     int by_second) {
     strmap_config_t config = strmap_config(sizeof(size_t), 0);
-    q->_queries_in_range = strmap_make_from_config(&config);
-    config.value_size = sizeof(void*);
-    q->_popular_queries = strmap_make_from_config(&config);
-    parse_range(&q->_user_range, range);
+    q->_nb_threads = nb_threads;
+    q->_workers = vec_make(worker_t, nb_threads, nb_threads);
+    for (size_t i = 0; i < nb_threads; ++i) {
+        worker_t* w = &q->_workers[i];
+        w->q = q;
+        w->shard = i;
+        w->lines = 0;
+        w->_key = vec_make(char, 0, 64);
+        w->_hll = NULL;
+        w->_topk = NULL;
+        w->_shards = vec_make(strmap_t, nb_threads, nb_threads);
+        for (size_t j = 0; j < nb_threads; ++j) {
+            w->_shards[j] = strmap_make_from_config(&config);
+        }
+    }
+    q->_queries_in_range = NULL;
+    q->_by_second = by_second;
+    q->_hll = NULL;
+    q->_topk = NULL;
+    q->_stats = NULL;
+    range_filter_init(&q->_filter, range);
+}
+
+/* Summarizes the queries with sketches instead of counting them: a HyperLogLog
+ * sketch of the given precision if it isn't 0, and a Space-Saving sketch with
+ * the given number of counters if it isn't 0. The first thread adds to the
+ * sketches of the whole input, and the others to their own ones merged after
+ * each call to qex_index.
+ * Returns 0 in case of error. */
+static int qex_init_approx(qex_t* q, size_t precision, size_t counters) {
+    int ok = 1;
+    for (size_t i = 0; i < q->_nb_threads; ++i) {
+        worker_t* w = &q->_workers[i];
+        if (precision != 0) {
+            w->_hll = hll_make((unsigned)precision);
+            ok = ok && w->_hll != NULL;
+        }
+        if (counters != 0) {
+            w->_topk = topk_make(counters);
+            ok = ok && w->_topk != NULL;
+        }
+    }
+    q->_hll = q->_workers[0]._hll;
+    q->_topk = q->_workers[0]._topk;
+    return ok;
 }
 
 static void qex_del(qex_t* q) {
-    strmap_del(q->_queries_in_range);
+    for (size_t i = 0; i < vec_len(q->_queries_in_range); ++i) {
+        strmap_del(q->_queries_in_range[i]);
+    }
+    vec_del(q->_queries_in_range);
+    for (size_t i = 0; i < q->_nb_threads; ++i) {
+        vec_del(q->_workers[i]._shards);
+        vec_del(q->_workers[i]._key);
+        hll_del(q->_workers[i]._hll);
+        topk_del(q->_workers[i]._topk);
+    }
+    vec_del(q->_workers);
+}
 
-    for (strmap_iterator_t it = strmap_iterator(q->_popular_queries);
-         strmap_next(&it);) {
-        char*** queries_ptr = it.val_ptr;
-        vec_del(*queries_ptr);
+/* Adds delta to the count of the query in the shard of the worker it hashes
+ * to. A query whose count drops to 0 is removed. */
+static void count_query(worker_t* w, const char* query, size_t query_size) {
+    const size_t nb_shards = w->q->_nb_threads;
+    strmap_t* shard = &w->_shards[0];
+    if (nb_shards > 1) {
+        /* the seed differs from the one of strmap, so that the queries of a
+         * shard still spread over all its buckets */
+        shard = &w->_shards[hash_bytes(query, query_size, QEX_SHARD_SEED) %
+                            nb_shards];
+    }
+
+    size_t* maybe_n = strmap_at_withlen(*shard, query, query_size);
+    if (maybe_n) {
+        *maybe_n += (size_t)w->delta;
+        if (*maybe_n == 0) {
+            strmap_erase_withlen(*shard, query, query_size);
+        }
+    } else {
+        *shard = strmap_addv_withlen(*shard, query, query_size, 1);
     }
-    strmap_del(q->_popular_queries);
 }
 
-static int qex_is_equal(const range_t* range, const range_t* user_range) {
-    return ((user_range->year & range->year) == range->year) &&
-           ((user_range->month & range->month) == range->month) &&
-           ((user_range->day & range->day) == range->day) &&
-           ((user_range->hour & range->hour) == range->hour) &&
-           ((user_range->minute & range->minute) == range->minute) &&
-           ((user_range->second & range->second) == range->second);
+/* Length of the date prefixing the keys of the queries counted per second. Each
+ * field is stored plus one in 5 bytes of 7 bits, whose high bit is set so that
+ * keys hold no NUL character. */
+#define DATED_KEY_LEN 30
+
+static void encode_date(char* key, const int date[6]) {
+    for (size_t i = 0; i < 6; ++i) {
+        uint32_t field = (uint32_t)date[i] + 1;
+        for (size_t j = 0; j < 5; ++j, field >>= 7) {
+            *key++ = (char)(0x80 | (field & 0x7f));
+        }
+    }
 }
 
-static char* index_tsv_line(qex_t* q, char* line) {
-    parse_range(&q->_range, line);
-    line = q->_range.end;
+static void decode_date(const char* key, int32_t date[6]) {
+    for (size_t i = 0; i < 6; ++i) {
+        uint32_t field = 0;
+        for (size_t j = 5; j-- > 0;) {
+            field = (field << 7) | ((unsigned char)key[i * 5 + j] & 0x7f);
+        }
+        date[i] = (int32_t)(field - 1);
+    }
+}
+
+/* Counts the query during the second of the date, as a query made of the
+ * encoded date followed by the query. */
+static void count_dated_query(worker_t* w, const int date[6],
+                              const char* query, size_t query_size) {
+    vec_resize(&w->_key, DATED_KEY_LEN + query_size);
+    if (!vec_valid(w->_key)) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(1);
+    }
+    encode_date(w->_key, date);
+    memcpy(w->_key + DATED_KEY_LEN, query, query_size);
+    count_query(w, w->_key, DATED_KEY_LEN + query_size);
+}
+
+/* Adds the query to the sketches of the worker. */
+static void sketch_query(worker_t* w, const char* query, size_t query_size) {
+    if (w->_hll != NULL) {
+        hll_add(w->_hll, hash_bytes(query, query_size, QEX_SKETCH_SEED));
+    }
+    if (w->_topk != NULL && !topk_add(w->_topk, query, query_size)) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(1);
+    }
+}
+
+/* Indexes the line starting at line in the buffer ending at end, which is left
+ * untouched: the query is handled as a (pointer, length) slice and only copied
+ * when it is added to the index.
+ * Returns the start of the next line, which is end after the last line, or NULL
+ * if the line is invalid. */
+static const char* index_tsv_line(worker_t* w, const char* line,
+                                  const char* end) {
+    /* decode the timestamp of well-formed lines at once, and fall back to the
+     * generic range parser for the others */
+    if (scan_timestamp(line, end, w->_range.date)) {
+        w->_range.end = line + SCAN_TIMESTAMP_LEN - 1;
+    } else {
+        parse_range(&w->_range, line, end);
+    }
+    line = w->_range.end;
 
     /* next_token should point to the character preceding the query, which
      * is `\t` in a TSV file. If not then an invalid line was given as input
      * argument.
      * The query is pointed by line here.
      */
-    if (*line != '\t') {
+    if (line == end || *line != '\t') {
         return NULL;
     }
-    char* query = ++line;
+    const char* query = ++line;
 
     /* go to end of query and save its length */
-    while (*line != '\n' && *line != '\r' && *line != 0) {
-        ++line;
-    }
+    line = scan_eol(line, end);
     size_t query_size = (size_t)(line - query);
 
-    /* remove endline characters and step to next line */
-    while (*line == '\n' || *line == '\r') {
-        *line = 0;
+    /* step over endline characters to next line */
+    while (line < end && (*line == '\n' || *line == '\r')) {
         ++line;
     }
 
     /* here, the entire line is parsed. If the range does not match with the
      * requested user one, do nothing more. */
-    if (qex_is_equal(&q->_range, &q->_user_range)) {
-        char* key = query;
-        key[query_size] = 0;
-        size_t* maybe_n =
-            strmap_at_withlen(q->_queries_in_range, key, query_size);
-        if (maybe_n) {
-            ++(*maybe_n);
+    if (range_filter_match(&w->q->_filter, w->_range.date)) {
+        if (w->q->_hll != NULL || w->q->_topk != NULL) {
+            sketch_query(w, query, query_size);
+        } else if (w->q->_by_second) {
+            count_dated_query(w, w->_range.date, query, query_size);
         } else {
-            q->_queries_in_range = strmap_addv(q->_queries_in_range, key, 1);
+            count_query(w, query, query_size);
         }
     }
 
-    /* returns null if this is the end of file */
-    return *line != 0 ? line : 0;
+    /* a NUL character ends the input */
+    return line < end && *line == 0 ? NULL : line;
+}
+
+/* Indexes the lines of the worker. */
+static void* index_tsv_lines(void* arg) {
+    worker_t* w = arg;
+    const char* line = w->begin;
+    size_t n = 0;
+    while (line != NULL && line < w->end) {
+        line = index_tsv_line(w, line, w->end);
+        ++n;
+    }
+    w->ok = line != NULL;
+    /* the invalid line isn't counted, and uncounted lines are subtracted */
+    n -= !w->ok;
+    w->lines = w->delta > 0 ? w->lines + n : w->lines - n;
+    return NULL;
 }
 
-static void build_most_popular_queries_set(qex_t* q) {
-    for (strmap_iterator_t it = strmap_iterator(q->_queries_in_range);
-         strmap_next(&it);) {
-        size_t n = *(size_t*)it.val_ptr;
-        char buf[100];
+/* Runs the function on the workers from the given one, each in its own thread
+ * but the first which runs in the calling thread. */
+static void run_workers(qex_t* q, size_t from, void* (*run)(void*)) {
+    for (size_t i = from + 1; i < q->_nb_threads; ++i) {
+        worker_t* w = &q->_workers[i];
+        if (pthread_create(&w->thread, NULL, run, w) != 0) {
+            fprintf(stderr, "error: failed to create thread\n");
+            exit(1);
+        }
+    }
+    run(&q->_workers[from]);
+    for (size_t i = from + 1; i < q->_nb_threads; ++i) {
+        pthread_join(q->_workers[i].thread, NULL);
+    }
+}
 
-        sprintf(buf, "%zu", n);
+/* Indexes the lines of [begin, end[, which starts after a newline if
+ * continuation is set, on all threads. The lines are split in as many ranges
+ * as threads, at newline boundaries.
+ * Returns 0 if an invalid line stopped the indexing. The lines after it are
+ * not counted, as if the lines were indexed sequentially. */
+static int qex_index(qex_t* q, const char* begin, const char* end,
+                     int continuation) {
+    const size_t n = q->_nb_threads;
+    const char* start = begin;
 
-        const char*** maybe_queries = strmap_at(q->_popular_queries, buf);
-        if (maybe_queries) {
-            vec_append(maybe_queries, it.key);
-        } else {
-            const char** queries = vec_make(const char*, 1, 10);
-            queries[0] = it.key;
-            q->_popular_queries =
-                strmap_addv(q->_popular_queries, buf, queries);
+    for (size_t i = 0; i < n; ++i) {
+        worker_t* w = &q->_workers[i];
+        const char* stop =
+            i + 1 == n ? end : begin + (size_t)(end - begin) / n * (i + 1);
+        if (stop < start) {
+            stop = start;
+        }
+        if (stop < end) {
+            const char* nl = memchr(stop, '\n', (size_t)(end - stop));
+            stop = nl != NULL ? nl + 1 : end;
+        }
+        w->begin = start;
+        w->end = stop;
+        w->delta = 1;
+        if (i > 0 || continuation) {
+            /* the previous range ended on a newline, which the parser would
+             * have stepped over with the following ones */
+            while (w->begin < w->end &&
+                   (*w->begin == '\n' || *w->begin == '\r')) {
+                ++w->begin;
+            }
+        }
+        start = stop;
+    }
+    run_workers(q, 0, index_tsv_lines);
+
+    size_t failed = 0;
+    while (failed < n && q->_workers[failed].ok) {
+        ++failed;
+    }
+    if (q->_hll != NULL || q->_topk != NULL) {
+        /* sketches can't be uncounted: the sketches of the ranges following
+         * the first invalid line are dropped instead of merged */
+        for (size_t i = 1; i < n; ++i) {
+            worker_t* w = &q->_workers[i];
+            int ok = 1;
+            if (w->_hll != NULL) {
+                if (i <= failed) {
+                    hll_merge(q->_hll, w->_hll);
+                }
+                hll_clear(w->_hll);
+            }
+            if (w->_topk != NULL) {
+                ok = (i > failed || topk_merge(q->_topk, w->_topk)) &&
+                     topk_clear(w->_topk);
+            }
+            if (!ok) {
+                fprintf(stderr, "error: out of memory\n");
+                exit(1);
+            }
+        }
+    } else if (failed + 1 < n) {
+        /* uncount the ranges following the first invalid line, which stop on
+         * the same lines as when they were counted */
+        for (size_t i = failed + 1; i < n; ++i) {
+            q->_workers[i].delta = -1;
+        }
+        run_workers(q, failed + 1, index_tsv_lines);
+    }
+    return failed == n;
+}
+
+/* Merges the shard of the worker of all the workers into its own. */
+static void* merge_shard(void* arg) {
+    worker_t* w = arg;
+    qex_t* q = w->q;
+    strmap_t* merged = &w->_shards[w->shard];
+
+    for (size_t i = 0; i < q->_nb_threads; ++i) {
+        strmap_t* shard = &q->_workers[i]._shards[w->shard];
+        if (shard == merged) {
+            continue;
+        }
+        for (strmap_iterator_t it = strmap_iterator(*shard);
+             strmap_next(&it);) {
+            const size_t n = *(size_t*)it.val_ptr;
+            size_t* maybe_n = strmap_at(*merged, it.key);
+            if (maybe_n) {
+                *maybe_n += n;
+            } else {
+                *merged = strmap_addv(*merged, it.key, n);
+            }
+        }
+        strmap_del(*shard);
+        *shard = NULL;
+    }
+    return NULL;
+}
+
+/* Merges the maps of all the threads, one shard per thread, into
+ * _queries_in_range. */
+static void qex_merge(qex_t* q) {
+    run_workers(q, 0, merge_shard);
+    q->_queries_in_range = vec_make(strmap_t, q->_nb_threads, q->_nb_threads);
+    for (size_t i = 0; i < q->_nb_threads; ++i) {
+        q->_queries_in_range[i] = q->_workers[i]._shards[i];
+    }
+}
+
+/* Drops the queries merged by qex_merge, so that the following calls to
+ * qex_index count the next lines from scratch. The sketches are kept. */
+static void qex_clear(qex_t* q) {
+    strmap_config_t config = strmap_config(sizeof(size_t), 0);
+    for (size_t i = 0; i < vec_len(q->_queries_in_range); ++i) {
+        strmap_del(q->_queries_in_range[i]);
+    }
+    vec_del(q->_queries_in_range);
+    q->_queries_in_range = NULL;
+    for (size_t i = 0; i < q->_nb_threads; ++i) {
+        worker_t* w = &q->_workers[i];
+        for (size_t j = 0; j < q->_nb_threads; ++j) {
+            w->_shards[j] = strmap_make_from_config(&config);
+        }
+    }
+}
+
+/* Returns the number of distinct queries in range. */
+static size_t qex_len(const qex_t* q) {
+    size_t len = 0;
+    for (size_t i = 0; i < vec_len(q->_queries_in_range); ++i) {
+        len += strmap_len(q->_queries_in_range[i]);
+    }
+    return len;
+}
+
+/* Returns the number of lines indexed. */
+static size_t qex_lines(const qex_t* q) {
+    size_t lines = 0;
+    for (size_t i = 0; i < q->_nb_threads; ++i) {
+        lines += q->_workers[i].lines;
+    }
+    return lines;
+}
+
+/* Indexes the file mapped in memory. Returns 0 if it can't be read. */
+static int index_mapped_file(qex_t* q, const char* file) {
+    /* map the file read-only: it is indexed in place and the index copies
+     * the queries it keeps, so the mapping is released right after. */
+    stats_begin(q->_stats, STATS_READ);
+    struct stat st;
+    const int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        /* pipes and devices have no size and can't be mapped */
+        close(fd);
+        return 0;
+    }
+    const size_t length = (size_t)st.st_size;
+    if (length == 0) {
+        close(fd);
+        return 1;
+    }
+    const char* buf = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED) {
+        return 0;
+    }
+    madvise((void*)buf, length, MADV_SEQUENTIAL);
+
+    /* the indexing stops on the first invalid line */
+    stats_begin(q->_stats, STATS_INDEX);
+    if (q->_stats != NULL) {
+        q->_stats->bytes += length;
+    }
+    qex_index(q, buf, buf + length, 0);
+    munmap((void*)buf, length);
+    return 1;
+}
+
+/* Indexes the files read by chunks of QEX_CHUNK_SIZE bytes, which are read
+ * ahead of the one being indexed by the pipelined reader. The partial line
+ * ending a chunk is carried over to the next one in a buffer which only grows
+ * for lines longer than a chunk. Returns 0 if a file can't be read. */
+static int index_streamed_files(qex_t* q, char* const* files, size_t nb_files,
+                                int reader_flags) {
+    reader_t* r = reader_open(files, nb_files, QEX_CHUNK_SIZE, QEX_READ_AHEAD,
+                              reader_flags);
+    char* carry = vec_make(char, 0, 1024);
+    if (r == NULL || carry == NULL) {
+        reader_close(r);
+        vec_del(carry);
+        return 0;
+    }
+
+    reader_chunk_t chunk;
+    size_t file = nb_files;
+    int continuation = 0;
+    int indexing = 0;
+    int ok = 1;
+    while (ok) {
+        stats_begin(q->_stats, STATS_READ);
+        if (!reader_next(r, &chunk)) {
+            break;
+        }
+        stats_begin(q->_stats, STATS_INDEX);
+        if (q->_stats != NULL) {
+            q->_stats->bytes += chunk.size;
+        }
+        if (chunk.file != file) {
+            printf("# OPEN\n");
+            printf("# INDEX\n");
+            file = chunk.file;
+            continuation = 0;
+            indexing = 1;
+        }
+        const char* begin = chunk.data;
+        const char* end = chunk.data + chunk.size;
+        if (!indexing) {
+            /* an invalid line stopped the indexing of the file */
+            continue;
+        }
+
+        if (vec_len(carry) > 0) {
+            /* complete the line carried over from the previous chunk */
+            const char* nl = memchr(begin, '\n', chunk.size);
+            const char* stop = nl != NULL ? nl + 1 : end;
+            const size_t len = vec_len(carry);
+            vec_resize(&carry, len + (size_t)(stop - begin));
+            ok = vec_valid(carry);
+            if (!ok) {
+                break;
+            }
+            memcpy(carry + len, begin, (size_t)(stop - begin));
+            begin = stop;
+            if (nl == NULL && !chunk.last) {
+                continue;
+            }
+            indexing =
+                qex_index(q, carry, carry + vec_len(carry), continuation);
+            continuation = 1;
+            vec_clear(&carry);
+        }
+
+        /* complete lines end at the last newline, or at the end of file */
+        const char* stop = end;
+        if (!chunk.last) {
+            while (stop > begin && stop[-1] != '\n') {
+                --stop;
+            }
+        }
+        if (indexing && stop > begin) {
+            indexing = qex_index(q, begin, stop, continuation);
+            continuation = 1;
         }
+        if (indexing && stop < end) {
+            vec_resize(&carry, (size_t)(end - stop));
+            ok = vec_valid(carry);
+            if (ok) {
+                memcpy(carry, stop, (size_t)(end - stop));
+            }
+        }
+        if (chunk.last) {
+            vec_clear(&carry);
+        }
+    }
+
+    ok = ok && reader_error(r) == 0;
+    reader_close(r);
+    vec_del(carry);
+    return ok;
+}
+
+/** A query in range and its number of occurrences. */
+typedef struct popular_query {
+    const char* query;
+    size_t count;
+} popular_query_t;
+
+/* Orders queries from the least to the most popular: by increasing count, then
+ * by decreasing query, so that the top of a min-heap is the first one to drop
+ * and ties are broken the same way whatever the hashing of the queries. */
+static bool popular_query_less(const popular_query_t* a,
+                               const popular_query_t* b) {
+    if (a->count != b->count) {
+        return a->count < b->count;
+    }
+    return strcmp(a->query, b->query) > 0;
+}
+
+static bool popular_queries_less(void* vec, size_t i, size_t j, void* ctx) {
+    (void)ctx;
+    const popular_query_t* v = vec;
+    return popular_query_less(&v[i], &v[j]);
+}
+
+/** The most popular queries added so far, in a min-heap. */
+typedef struct top_queries {
+    popular_query_t* heap;
+    size_t num;
+    /**< Number of queries kept */
+} top_queries_t;
+
+/* Returns 0 in case of error. */
+static int top_queries_init(top_queries_t* t, size_t num) {
+    t->num = num;
+    t->heap = vec_make(popular_query_t, 0, num);
+    return t->heap != NULL;
+}
+
+/* Adds the query, which is kept if it is one of the num most popular ones. */
+static void top_queries_add(top_queries_t* t, const char* query,
+                            size_t count) {
+    const popular_query_t q = {query, count};
+    if (vec_len(t->heap) < t->num) {
+        heap_push(&t->heap, q, popular_queries_less, NULL);
+    } else if (t->num > 0 && popular_query_less(&heap_peek(t->heap), &q)) {
+        /* the query replaces the least popular one, at the top of the heap */
+        heap_replace_top(t->heap, q, popular_queries_less, NULL);
     }
 }
 
-static bool popular_queries_sorter(void* vec, size_t i, size_t j) {
-    char** v = vec;
-    return atoi(v[i]) > atoi(v[j]);
+/* Prints the queries kept by decreasing count then by increasing query to out,
+ * and deletes them. */
+static void top_queries_print(top_queries_t* t, FILE* out) {
+    /* popping the heap leaves the queries from the most to the least popular
+     * in place, past its length: restore the length, which is within the
+     * capacity, before reading them */
+    const size_t len = vec_len(t->heap);
+    for (size_t n = len; n > 0; --n) {
+        heap_pop(&t->heap, popular_queries_less, NULL);
+    }
+    vec_resize(&t->heap, len);
+    for (size_t i = 0; i < len; ++i) {
+        fprintf(out, "%s %zu\n", t->heap[i].query, t->heap[i].count);
+    }
+    vec_del(t->heap);
 }
 
+/* Prints the num most popular queries in range, by decreasing count then by
+ * increasing query. They are selected in one pass over the queries with a
+ * min-heap holding the num most popular queries seen so far. */
 static void print_nth_most_popular_queries(qex_t* q, size_t num) {
-    const char** ns = vec_make(const char*, 0, strmap_len(q->_popular_queries));
-    for (strmap_iterator_t it = strmap_iterator(q->_popular_queries);
-         strmap_next(&it);) {
-        vec_append(&ns, it.key);
-    }
-    vec_sort(ns, popular_queries_sorter);
-    for (size_t i = 0; i < vec_len(ns); ++i) {
-        const char* num_queries = ns[i];
-        char*** queries = strmap_at(q->_popular_queries, num_queries);
-        for (size_t j = 0; j < vec_len(*queries); ++j) {
-            char* query = (*queries)[j];
-            if (num-- == 0) {
-                goto end;
+    const size_t len = qex_len(q);
+    top_queries_t top;
+    if (!top_queries_init(&top, num < len ? num : len)) {
+        return;
+    }
+    for (size_t i = 0; i < vec_len(q->_queries_in_range); ++i) {
+        strmap_t shard = q->_queries_in_range[i];
+        for (strmap_iterator_t it = strmap_iterator(shard);
+             strmap_next(&it);) {
+            top_queries_add(&top, it.key, *(size_t*)it.val_ptr);
+        }
+    }
+    stats_begin(q->_stats, STATS_OUTPUT);
+    top_queries_print(&top, stdout);
+}
+
+static int approx_query_cmp(const void* a, const void* b) {
+    const topk_counter_t* x = *(const topk_counter_t* const*)a;
+    const topk_counter_t* y = *(const topk_counter_t* const*)b;
+    if (x->count != y->count) {
+        return x->count > y->count ? -1 : 1;
+    }
+    return strcmp(x->key, y->key);
+}
+
+/* Prints the estimated number of distinct queries in range, or the num most
+ * popular queries found by the sketches, with their error bounds. */
+static void print_approx_queries(const qex_t* q, size_t num) {
+    if (q->_hll != NULL) {
+        printf("%.0f +-%.2f%%\n", hll_estimate(q->_hll),
+               100 * hll_error(q->_hll));
+        return;
+    }
+    const size_t len = topk_len(q->_topk);
+    const topk_counter_t* counters = topk_counters(q->_topk);
+    const topk_counter_t** sorted = malloc((len + 1) * sizeof(void*));
+    if (sorted == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        sorted[i] = &counters[i];
+    }
+    qsort(sorted, len, sizeof(void*), approx_query_cmp);
+    for (size_t i = 0; i < len && i < num; ++i) {
+        printf("%s %zu +-%zu\n", sorted[i]->key, sorted[i]->count,
+               sorted[i]->error);
+    }
+    free(sorted);
+}
+
+/************************* Persistent index **********************************/
+
+/** A query counted during a second, as read from the index. */
+typedef struct dated_count {
+    int32_t date[6];
+    uint32_t id;
+    uint32_t count;
+} dated_count_t;
+
+static int dated_count_cmp(const void* a, const void* b) {
+    const dated_count_t* x = a;
+    const dated_count_t* y = b;
+    const int cmp = store_date_cmp(x->date, y->date, 6);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/** An interned query and its id. */
+typedef struct interned_query {
+    const char* query;
+    uint32_t id;
+} interned_query_t;
+
+static int interned_query_cmp(const void* a, const void* b) {
+    return strcmp(((const interned_query_t*)a)->query,
+                  ((const interned_query_t*)b)->query);
+}
+
+/* Builds the store of the queries counted per second in memory. The queries
+ * are interned as their counts are gathered, then given ids in alphabetical
+ * order, so that the store doesn't depend on the order of the shards. Then
+ * their counts are sorted by date and grouped in one bucket per second.
+ * The sections of the store are freed by free_store.
+ * Returns 0 in case of error. */
+static int qex_build_store(qex_t* q, store_t* store_ptr) {
+    const size_t nb_counts = qex_len(q);
+    strset_t* interned = strset_make(0);
+    dated_count_t* counts = malloc((nb_counts + 1) * sizeof(dated_count_t));
+    int ok = interned != NULL && counts != NULL;
+
+    /* gather the counts and intern their queries, in order of appearance */
+    size_t n = 0;
+    for (size_t i = 0; ok && i < vec_len(q->_queries_in_range); ++i) {
+        strmap_t shard = q->_queries_in_range[i];
+        for (strmap_iterator_t it = strmap_iterator(shard);
+             ok && strmap_next(&it);) {
+            dated_count_t* c = &counts[n++];
+            decode_date(it.key, c->date);
+            c->id = strset_intern(interned,
+                                  (const char*)it.key + DATED_KEY_LEN);
+            c->count = (uint32_t)*(size_t*)it.val_ptr;
+            ok = c->id != STRSET_NONE && c->count == *(size_t*)it.val_ptr;
+        }
+    }
+
+    /* number the queries in alphabetical order */
+    store_t store;
+    store.nb_queries = ok ? strset_len(interned) : 0;
+    store.strings_size = 0;
+    interned_query_t* queries =
+        malloc((store.nb_queries + 1) * sizeof(interned_query_t));
+    uint32_t* ids = malloc((store.nb_queries + 1) * sizeof(uint32_t));
+    uint64_t* offsets = malloc((store.nb_queries + 1) * sizeof(uint64_t));
+    ok = ok && queries != NULL && ids != NULL && offsets != NULL;
+    if (ok) {
+        for (size_t i = 0; i < store.nb_queries; ++i) {
+            queries[i].query = strset_str(interned, (uint32_t)i);
+            queries[i].id = (uint32_t)i;
+        }
+        qsort(queries, store.nb_queries, sizeof(interned_query_t),
+              interned_query_cmp);
+        for (size_t i = 0; i < store.nb_queries; ++i) {
+            ids[queries[i].id] = (uint32_t)i;
+            offsets[i] = store.strings_size;
+            store.strings_size += strset_strlen(interned, queries[i].id) + 1;
+        }
+        offsets[store.nb_queries] = store.strings_size;
+    }
+    char* strings = ok ? malloc(store.strings_size + 1) : NULL;
+    ok = ok && strings != NULL;
+    for (size_t i = 0; ok && i < store.nb_queries; ++i) {
+        memcpy(strings + offsets[i], queries[i].query,
+               (size_t)(offsets[i + 1] - offsets[i]));
+    }
+
+    /* sort the counts of the queries by date */
+    for (size_t i = 0; ok && i < nb_counts; ++i) {
+        counts[i].id = ids[counts[i].id];
+    }
+    if (ok) {
+        qsort(counts, nb_counts, sizeof(dated_count_t), dated_count_cmp);
+    }
+
+    /* group the counts in buckets */
+    store.nb_postings = nb_counts;
+    store_bucket_t* buckets = vec_make(store_bucket_t, 0, 1024);
+    store_posting_t* postings =
+        malloc((nb_counts + 1) * sizeof(store_posting_t));
+    ok = ok && buckets != NULL && postings != NULL;
+    for (size_t i = 0; ok && i < nb_counts; ++i) {
+        if (i == 0 ||
+            store_date_cmp(counts[i - 1].date, counts[i].date, 6) != 0) {
+            store_bucket_t b;
+            memcpy(b.date, counts[i].date, sizeof(b.date));
+            b.postings = i;
+            vec_append(&buckets, b);
+        }
+        postings[i].id = counts[i].id;
+        postings[i].count = counts[i].count;
+    }
+    const store_bucket_t end = {{0}, nb_counts};
+    if (ok) {
+        vec_append(&buckets, end);
+        ok = vec_valid(buckets);
+    }
+
+    if (ok) {
+        store.buckets = buckets;
+        store.nb_buckets = vec_len(buckets) - 1;
+        store.postings = postings;
+        store.offsets = offsets;
+        store.strings = strings;
+        store._map = NULL;
+        store._map_size = 0;
+        *store_ptr = store;
+    } else {
+        vec_del(buckets);
+        free(postings);
+        free(strings);
+        free(offsets);
+    }
+
+    free(counts);
+    free(queries);
+    free(ids);
+    strset_del(interned);
+    return ok;
+}
+
+/* Frees the sections of a store built by qex_build_store. */
+static void free_store(store_t* store) {
+    vec_del((void*)store->buckets);
+    free((void*)store->postings);
+    free((void*)store->strings);
+    free((void*)store->offsets);
+}
+
+/* Prints the number of distinct queries of the store in the range, or its num
+ * most popular queries if num isn't 0, to out. Only the buckets starting with
+ * the fields the range gives before its first wildcard are read.
+ * Returns 0 if the store is corrupted. */
+static int query_store(const store_t* store, const char* range, size_t num,
+                       FILE* out) {
+    range_filter_t filter;
+    range_filter_init(&filter, range);
+    int32_t prefix[6];
+    size_t prefix_len = 0;
+    while (prefix_len < 6 && filter.range.date[prefix_len] != -1) {
+        prefix[prefix_len] = filter.range.date[prefix_len];
+        ++prefix_len;
+    }
+    size_t first, last;
+    store_find_buckets(store, prefix, prefix_len, &first, &last);
+
+    /* sum the counts of the queries in range, and keep the ids of the
+     * distinct ones */
+    uint64_t* counts = calloc(store->nb_queries + 1, sizeof(uint64_t));
+    uint32_t* ids = vec_make(uint32_t, 0, 1024);
+    int ok = counts != NULL && ids != NULL;
+    for (size_t i = first; ok && i < last; ++i) {
+        const store_bucket_t* b = &store->buckets[i];
+        const int date[6] = {b->date[0], b->date[1], b->date[2],
+                             b->date[3], b->date[4], b->date[5]};
+        if (!range_filter_match(&filter, date)) {
+            continue;
+        }
+        for (uint64_t j = b[0].postings; j < b[1].postings; ++j) {
+            const store_posting_t p = store->postings[j];
+            if (p.id >= store->nb_queries) {
+                ok = 0;
+                break;
+            }
+            if (counts[p.id] == 0) {
+                vec_append(&ids, p.id);
+            }
+            counts[p.id] += p.count;
+        }
+    }
+    ok = ok && vec_valid(ids);
+
+    if (ok && num == 0) {
+        fprintf(out, "%zu\n", vec_len(ids));
+    } else if (ok) {
+        top_queries_t top;
+        const size_t len = vec_len(ids);
+        ok = top_queries_init(&top, num < len ? num : len);
+        for (size_t i = 0; ok && i < len; ++i) {
+            const char* query = store_query(store, ids[i]);
+            ok = query != NULL;
+            if (ok) {
+                top_queries_add(&top, query, (size_t)counts[ids[i]]);
+            }
+        }
+        if (ok) {
+            top_queries_print(&top, out);
+        } else {
+            vec_del(top.heap);
+        }
+    }
+
+    vec_del(ids);
+    free(counts);
+    return ok;
+}
+
+/* Answers a request of qex serve from the store. */
+static void serve_request(void* ctx, const char* request, size_t size,
+                          FILE* out) {
+    const store_t* store = ctx;
+    char line[SERVE_MAX_REQUEST + 1];
+    if (size > SERVE_MAX_REQUEST) {
+        size = SERVE_MAX_REQUEST;
+    }
+    memcpy(line, request, size);
+    line[size] = 0;
+
+    /* split the command from its arguments */
+    char* args = line + strcspn(line, " \t");
+    if (*args != 0) {
+        *args++ = 0;
+    }
+    args += strspn(args, " \t");
+
+    size_t num = 0;
+    if (0 == strcmp("TOP", line)) {
+        char* end = NULL;
+        const long long n = strtoll(args, &end, 10);
+        if (end == args || n < 1) {
+            fprintf(out, "ERROR positive integer expected after TOP\n");
+            return;
+        }
+        num = (size_t)n;
+        args = end + strspn(end, " \t");
+    } else if (0 != strcmp("COUNT", line)) {
+        fprintf(out, "ERROR unknown request %s\n", line);
+        return;
+    }
+    if (!query_store(store, *args != 0 ? args : NULL, num, out)) {
+        fprintf(out, "ERROR failed to read index\n");
+    }
+}
+
+/************************* Follow mode ***************************************/
+
+/** An input file followed as it grows. */
+typedef struct followed {
+    int fd;
+    off_t offset;
+    /**< Offset of the first line not indexed yet */
+    int continuation;
+    /**< Whether lines were indexed before the offset */
+    int indexing;
+    /**< Whether no invalid line stopped the indexing of the file */
+} followed_t;
+
+/** State of the follow mode. */
+typedef struct follow {
+    followed_t* files;
+    char* buf;
+    /**< Lines read from a file, by chunks of QEX_CHUNK_SIZE bytes */
+    strmap_t totals;
+    /**< Number of times each query in range was done in all the refreshes */
+    char** top;
+    /**< Copies of the most popular queries of the last refresh */
+} follow_t;
+
+/* Indexes the complete lines appended to the file since the last call. A
+ * partial last line is read again by the next call, once complete.
+ * Returns 0 if the file can't be read. */
+static int follow_file(qex_t* q, followed_t* file, char** buf) {
+    struct stat st;
+    if (fstat(file->fd, &st) != 0) {
+        return 0;
+    }
+    if (st.st_size < file->offset) {
+        /* the file was truncated, and is indexed again from its start */
+        file->offset = 0;
+        file->continuation = 0;
+        file->indexing = 1;
+    }
+
+    /* len bytes of the buffer hold the start of a line read ahead */
+    size_t len = 0;
+    while (file->indexing) {
+        if (len == vec_len(*buf)) {
+            /* the buffer holds a single partial line */
+            vec_resize(buf, len > 0 ? len * 2 : QEX_CHUNK_SIZE);
+            if (!vec_valid(*buf)) {
+                return 0;
+            }
+        }
+        const ssize_t n = pread(file->fd, *buf + len, vec_len(*buf) - len,
+                                file->offset + (off_t)len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return n == 0;
+        }
+        len += (size_t)n;
+
+        /* complete lines end at the last newline */
+        const char* end = *buf + len;
+        while (end > *buf && end[-1] != '\n') {
+            --end;
+        }
+        if (end == *buf) {
+            continue;
+        }
+        file->indexing = qex_index(q, *buf, end, file->continuation);
+        file->continuation = 1;
+        file->offset += end - *buf;
+        len = (size_t)(*buf + len - end);
+        memmove(*buf, end, len);
+    }
+    return 1;
+}
+
+/* Returns the number of times the query was done in the lines indexed since
+ * the last refresh, or 0 if none. */
+static size_t qex_count(const qex_t* q, const char* query) {
+    for (size_t i = 0; i < vec_len(q->_queries_in_range); ++i) {
+        const size_t* maybe_n = strmap_at(q->_queries_in_range[i], query);
+        if (maybe_n != NULL) {
+            return *maybe_n;
+        }
+    }
+    return 0;
+}
+
+/* Adds the queries counted since the last refresh to the totals, and prints
+ * the number of distinct queries or the num most popular ones, before
+ * clearing the queries of the qex object. Counts only grow, so the most
+ * popular queries are among the ones of the last refresh and the ones done
+ * since: the cost of a refresh only depends on the lines indexed since the
+ * last one.
+ * Returns 0 in case of error. */
+static int follow_refresh(follow_t* f, qex_t* q, size_t num, int approx) {
+    qex_merge(q);
+    top_queries_t top;
+    if (!top_queries_init(&top, approx ? 0 : num)) {
+        return 0;
+    }
+    for (size_t i = 0; i < vec_len(q->_queries_in_range); ++i) {
+        for (strmap_iterator_t it = strmap_iterator(q->_queries_in_range[i]);
+             strmap_next(&it);) {
+            const size_t n = *(size_t*)it.val_ptr;
+            size_t* maybe_total = strmap_at(f->totals, it.key);
+            if (maybe_total != NULL) {
+                *maybe_total += n;
+            } else {
+                f->totals = strmap_addv(f->totals, it.key, n);
+                if (f->totals == NULL) {
+                    vec_del(top.heap);
+                    return 0;
+                }
+            }
+            top_queries_add(&top, it.key, maybe_total ? *maybe_total : n);
+        }
+    }
+    for (size_t i = 0; i < vec_len(f->top); ++i) {
+        if (qex_count(q, f->top[i]) == 0) {
+            top_queries_add(&top, f->top[i],
+                            *(size_t*)strmap_at(f->totals, f->top[i]));
+        }
+    }
+
+    /* keep copies of the most popular queries, as the queries of the qex
+     * object are cleared */
+    const size_t len = vec_len(top.heap);
+    char** kept = vec_make(char*, len, len);
+    int ok = kept != NULL;
+    for (size_t i = 0; ok && i < len; ++i) {
+        kept[i] = strdup(top.heap[i].query);
+        ok = kept[i] != NULL;
+    }
+
+    if (approx) {
+        print_approx_queries(q, num);
+        vec_del(top.heap);
+    } else if (num == 0) {
+        printf("%zu\n", strmap_len(f->totals));
+        vec_del(top.heap);
+    } else {
+        top_queries_print(&top, stdout);
+    }
+    fflush(stdout);
+
+    for (size_t i = 0; i < vec_len(f->top); ++i) {
+        free(f->top[i]);
+    }
+    vec_del(f->top);
+    f->top = kept;
+    qex_clear(q);
+    return ok;
+}
+
+/* Indexes the files, then the lines appended to them as they are written,
+ * and prints the results after each refresh. The files are watched with
+ * inotify, or polled at each interval if it is unavailable.
+ * Returns only in case of error. */
+static void follow(qex_t* q, char* const* files, size_t nb_files, size_t num,
+                   int approx) {
+    follow_t f;
+    f.files = vec_make(followed_t, nb_files, nb_files);
+    f.buf = vec_make(char, 0, QEX_CHUNK_SIZE);
+    f.totals = strmap_make(sizeof(size_t), 0);
+    f.top = vec_make(char*, 0, num);
+    const int inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (f.files == NULL || f.buf == NULL || f.totals == NULL ||
+        f.top == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < nb_files; ++i) {
+        followed_t* file = &f.files[i];
+        file->fd = open(files[i], O_RDONLY | O_CLOEXEC);
+        file->offset = 0;
+        file->continuation = 0;
+        file->indexing = 1;
+        if (file->fd < 0) {
+            return;
+        }
+        if (inotify >= 0) {
+            inotify_add_watch(inotify, files[i], IN_MODIFY);
+        }
+    }
+
+    int refreshes = 0;
+    while (1) {
+        for (size_t i = 0; i < nb_files; ++i) {
+            if (refreshes == 0) {
+                printf("# OPEN\n");
+                printf("# INDEX\n");
+            }
+            if (!follow_file(q, &f.files[i], &f.buf)) {
+                return;
+            }
+        }
+        printf(refreshes++ == 0 ? "# COMPUTE\n" : "# UPDATE\n");
+        if (!follow_refresh(&f, q, num, approx)) {
+            return;
+        }
+
+        /* wait for a file to change, then for the end of the interval */
+        struct timespec last;
+        clock_gettime(CLOCK_MONOTONIC, &last);
+        if (inotify >= 0) {
+            struct pollfd p = {inotify, POLLIN, 0};
+            char events[4096];
+            while (poll(&p, 1, -1) < 0 && errno == EINTR) {
+            }
+            while (read(inotify, events, sizeof(events)) > 0) {
+            }
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        const long elapsed = (now.tv_sec - last.tv_sec) * 1000 +
+                             (now.tv_nsec - last.tv_nsec) / 1000000;
+        if (elapsed < QEX_FOLLOW_INTERVAL) {
+            const long left = QEX_FOLLOW_INTERVAL - elapsed;
+            struct timespec delay = {left / 1000, left % 1000 * 1000000};
+            while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
             }
-            printf("%s %s\n", query, num_queries);
         }
     }
-end:
-    vec_del(ns);
 }
 
 /************************* Entry point ***************************************/
@@ -320,53 +1698,133 @@ int main(int argc, char** argv) {
         exit(1);
     }
 
+    if (args.command == COMMAND_QUERY) {
+        /* extract queries from the index mapped in memory */
+        printf("# OPEN\n");
+        store_t store;
+        if (!store_open(&store, args.files[0])) {
+            printf("failed to read index\n");
+            exit(1);
+        }
+        printf("# COMPUTE\n");
+        const int ok = query_store(&store, args.range, args.num, stdout);
+        store_close(&store);
+        if (!ok) {
+            printf("corrupted index\n");
+            exit(1);
+        }
+        vec_del(args.files);
+        return 0;
+    }
+
     /* index input files */
     qex_t qex;
-    qex_init(&qex, args.range);
-    strmap_t buffers = strmap_make(sizeof(char*), vec_len(args.files));
+    qex_init(&qex, args.range, args.jobs,
+             args.command == COMMAND_INDEX || args.command == COMMAND_SERVE);
+    if (args.approx &&
+        !qex_init_approx(&qex, args.num == 0 ? args.precision : 0,
+                         args.num == 0 ? 0 : args.counters)) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(1);
+    }
+    stats_t stats;
+    if (args.stats) {
+        /* before the indexing threads, so that their events are counted */
+        stats_init(&stats);
+        qex._stats = &stats;
+    }
 
-    for (size_t i = 0; i < vec_len(args.files); ++i) {
-        printf("# OPEN\n");
-        char* file = args.files[i];
-        /* read whole file content into buffer */
-        FILE* f = fopen(file, "r");
-        fseek(f, 0, SEEK_END);
-        size_t length = (size_t)ftell(f);
-        fseek(f, 0, SEEK_SET);
-        char* buf = malloc(sizeof(char) * length + 1);
-        buffers = strmap_addv(buffers, file, buf);
-        if (fread(buf, length, 1, f) != 1) {
+    const int reader_flags = args.no_uring ? READER_THREADS : 0;
+    if (args.follow) {
+        /* index the files as they grow until interrupted */
+        follow(&qex, args.files, vec_len(args.files), args.num, args.approx);
+        printf("failed to read file\n");
+        exit(1);
+    }
+    if (args.stream) {
+        /* index the files read ahead while the previous ones are indexed */
+        if (!index_streamed_files(&qex, args.files, vec_len(args.files),
+                                  reader_flags)) {
             printf("failed to read file\n");
             exit(1);
         }
-        buf[length] = 0;
-        fclose(f);
+    }
+    for (size_t i = 0; !args.stream && i < vec_len(args.files); ++i) {
+        char* file = args.files[i];
+        struct stat st;
+        if (stat(file, &st) == 0 && !S_ISREG(st.st_mode)) {
+            /* pipes, such as /dev/stdin or <(zcat FILE), report no size and
+             * can't be mapped: they are read by chunks instead */
+            if (!index_streamed_files(&qex, &args.files[i], 1, reader_flags)) {
+                printf("failed to read file\n");
+                exit(1);
+            }
+            continue;
+        }
+        printf("# OPEN\n");
 
         printf("# INDEX\n");
-        /* index the file using Qex object and catch eventual errors */
-        for (char* line = buf; line; line = index_tsv_line(&qex, line)) {
-            if (line == NULL) {
-                fprintf(stderr, "error\n");
-                break;
-            }
+        /* index the file using Qex object */
+        if (!index_mapped_file(&qex, file)) {
+            printf("failed to read file\n");
+            exit(1);
         }
     }
 
     printf("# COMPUTE\n");
+    stats_begin(qex._stats, STATS_COMPUTE);
+    qex_merge(&qex);
+    if (qex._stats != NULL) {
+        qex._stats->lines = qex_lines(&qex);
+    }
 
     /* extract queries based on input arguments */
-    if (args.num == 0) {
-        printf("%zu\n", strmap_len(qex._queries_in_range));
+    if (args.command == COMMAND_INDEX) {
+        store_t store;
+        if (!qex_build_store(&qex, &store)) {
+            printf("failed to write index\n");
+            exit(1);
+        }
+        stats_begin(qex._stats, STATS_OUTPUT);
+        if (!store_write(&store, args.output)) {
+            printf("failed to write index\n");
+            exit(1);
+        }
+        free_store(&store);
+    } else if (args.command == COMMAND_SERVE) {
+        store_t store;
+        if (!qex_build_store(&qex, &store)) {
+            printf("failed to build index\n");
+            exit(1);
+        }
+        /* the stats of the indexing, as serving lasts until interrupted */
+        stats_end(qex._stats);
+        stats_print(qex._stats, stderr);
+        printf("# SERVE\n");
+        fflush(stdout);
+        if (!serve(args.socket, serve_request, &store)) {
+            printf("failed to serve on %s\n", args.socket);
+            exit(1);
+        }
+        free_store(&store);
+    } else if (args.approx) {
+        stats_begin(qex._stats, STATS_OUTPUT);
+        print_approx_queries(&qex, args.num);
+    } else if (args.num == 0) {
+        stats_begin(qex._stats, STATS_OUTPUT);
+        printf("%zu\n", qex_len(&qex));
     } else {
-        build_most_popular_queries_set(&qex);
         print_nth_most_popular_queries(&qex, args.num);
     }
-
-    for (strmap_iterator_t it = strmap_iterator(buffers); strmap_next(&it);) {
-        char** buffer = it.val_ptr;
-        free(*buffer);
+    if (args.stats && args.command != COMMAND_SERVE) {
+        fflush(stdout);
+        stats_end(qex._stats);
+        stats_print(qex._stats, stderr);
     }
-    strmap_del(buffers);
+    if (args.stats) {
+        stats_del(&stats);
+    }
+
     qex_del(&qex);
 
     vec_del(args.files);
@@ -0,0 +1,560 @@
+#define _GNU_SOURCE
+#include "reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/* Largest number of threads of the thread pool. */
+#define READER_MAX_THREADS 4
+
+typedef enum slot_state {
+    SLOT_QUEUED,
+    /**< Waiting for a thread of the pool */
+    SLOT_READING,
+    SLOT_DONE,
+    /**< Read, or failed with an error */
+} slot_state_t;
+
+/* A chunk being read in its buffer. */
+typedef struct slot {
+    char* buf;
+    int fd;
+    size_t file;
+    off_t offset;
+    /**< Offset of the chunk in the file, or -1 to read a file which can't
+     * seek from its current position */
+    size_t size;
+    /**< Bytes to read */
+    size_t len;
+    /**< Bytes read */
+    int last;
+    /**< Whether the chunk ends its file, and closes its descriptor */
+    int error;
+    slot_state_t state;
+    struct iovec iov;
+    /**< Part of the buffer left to read, for io_uring */
+} slot_t;
+
+/* An io_uring instance set up with raw system calls. */
+typedef struct uring {
+    int fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    size_t inflight;
+} uring_t;
+
+struct reader {
+    char* const* files;
+    size_t nb_files;
+    size_t chunk_size;
+    size_t depth;
+    slot_t* slots;
+    /**< Ring of the chunks read ahead */
+    size_t head;
+    /**< Number of the chunk returned next */
+    size_t tail;
+    /**< Number of the next chunk to read. [head, tail[ are being read */
+    int returned;
+    /**< Whether the chunk at head was returned, and is recycled next */
+    int error;
+
+    size_t file;
+    int fd;
+    off_t size;
+    off_t offset;
+    /**< Next chunk to read: file, its descriptor if open and its size, or -1
+     * if it can't seek, and the offset of the chunk */
+    size_t pending;
+    /**< Number of the last chunk of a file which can't seek, read before its
+     * next one */
+
+    int use_uring;
+    uring_t uring;
+
+    pthread_t threads[READER_MAX_THREADS];
+    size_t nb_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_cond_t done;
+    /**< Signaled when a chunk is queued for the pool, and when it is read */
+    size_t next_job;
+    /**< Number of the next chunk a thread of the pool may read */
+    int stop;
+};
+
+/********************************* io_uring **********************************/
+
+static int uring_enter(uring_t* u, unsigned to_submit, unsigned min_complete) {
+    const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (syscall(__NR_io_uring_enter, u->fd, to_submit, min_complete, flags,
+                   NULL, 0) < 0) {
+        if (errno != EINTR) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Sets up an io_uring instance of the given number of entries. Returns 0 if
+ * io_uring is unavailable. */
+static int uring_init(uring_t* u, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    u->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (u->fd < 0) {
+        return 0;
+    }
+    u->inflight = 0;
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_size =
+        p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        /* both rings share a mapping */
+        if (u->cq_ring_size > u->sq_ring_size) {
+            u->sq_ring_size = u->cq_ring_size;
+        }
+        u->cq_ring_size = u->sq_ring_size;
+    }
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    u->cq_ring = u->sq_ring;
+    if (u->sq_ring != MAP_FAILED && !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sq_ring == MAP_FAILED || u->cq_ring == MAP_FAILED ||
+        u->sqes == MAP_FAILED) {
+        if (u->sqes != MAP_FAILED) {
+            munmap(u->sqes, u->sqes_size);
+        }
+        if (u->cq_ring != MAP_FAILED && u->cq_ring != u->sq_ring) {
+            munmap(u->cq_ring, u->cq_ring_size);
+        }
+        if (u->sq_ring != MAP_FAILED) {
+            munmap(u->sq_ring, u->sq_ring_size);
+        }
+        close(u->fd);
+        return 0;
+    }
+
+    char* sq = u->sq_ring;
+    char* cq = u->cq_ring;
+    u->sq_head = (unsigned*)(sq + p.sq_off.head);
+    u->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    u->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned*)(sq + p.sq_off.array);
+    u->cq_head = (unsigned*)(cq + p.cq_off.head);
+    u->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    u->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 1;
+}
+
+static void uring_del(uring_t* u) {
+    munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != u->sq_ring) {
+        munmap(u->cq_ring, u->cq_ring_size);
+    }
+    munmap(u->sq_ring, u->sq_ring_size);
+    close(u->fd);
+}
+
+/* Submits the read of the rest of the slot, whose number is i. The ring has
+ * an entry per slot, so it is never full. Returns 0 if the read isn't
+ * submitted, in which case the entry is withdrawn from the ring. */
+static int uring_read(uring_t* u, slot_t* s, size_t i) {
+    s->iov.iov_base = s->buf + s->len;
+    s->iov.iov_len = s->size - s->len;
+
+    const unsigned tail = *u->sq_tail;
+    const unsigned index = tail & *u->sq_mask;
+    struct io_uring_sqe* sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = s->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&s->iov;
+    sqe->len = 1;
+    sqe->off = s->offset < 0 ? (uint64_t)-1 : (uint64_t)(s->offset + s->len);
+    sqe->user_data = i;
+    u->sq_array[index] = index;
+    /* the kernel reads the entry once it sees the new tail */
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    const int entered = uring_enter(u, 1, 0);
+    if (__atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) == tail) {
+        /* the kernel didn't consume the entry: a later submission would read
+         * into the buffer once it is recycled, so the tail is moved back */
+        __atomic_store_n(u->sq_tail, tail, __ATOMIC_RELEASE);
+        if (entered) {
+            errno = EAGAIN;
+        }
+        return 0;
+    }
+    /* a consumed entry completes even if the call failed afterwards */
+    ++u->inflight;
+    return 1;
+}
+
+/* Waits for at least one completion, and handles them all. Short reads are
+ * resubmitted until their slot is full or the end of its file is reached. */
+static void uring_complete(reader_t* r) {
+    uring_t* u = &r->uring;
+    if (!uring_enter(u, 0, 1)) {
+        r->error = errno;
+        return;
+    }
+    unsigned head = *u->cq_head;
+    const unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe* cqe = &u->cqes[head & *u->cq_mask];
+        const size_t i = (size_t)cqe->user_data;
+        slot_t* s = &r->slots[i];
+        const int res = cqe->res;
+        --u->inflight;
+
+        if (res == -EINTR || res == -EAGAIN) {
+            s->error = uring_read(u, s, i) ? 0 : errno;
+        } else if (res < 0) {
+            s->error = -res;
+        } else if (res == 0) {
+            /* end of file */
+            s->last = s->last || s->offset < 0;
+        } else {
+            s->len += (size_t)res;
+            if (s->len < s->size) {
+                s->error = uring_read(u, s, i) ? 0 : errno;
+                if (s->error == 0) {
+                    continue;
+                }
+            }
+        }
+        if (s->error != 0 || res >= 0) {
+            s->state = SLOT_DONE;
+        }
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/******************************** Thread pool *********************************/
+
+/* Reads the slot with blocking system calls. */
+static void read_slot(slot_t* s) {
+    while (s->len < s->size) {
+        char* p = s->buf + s->len;
+        const size_t n = s->size - s->len;
+        const ssize_t res = s->offset < 0
+                                ? read(s->fd, p, n)
+                                : pread(s->fd, p, n, s->offset + (off_t)s->len);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            s->error = errno;
+            return;
+        }
+        if (res == 0) {
+            /* end of file */
+            s->last = s->last || s->offset < 0;
+            return;
+        }
+        s->len += (size_t)res;
+    }
+}
+
+static void* read_slots(void* arg) {
+    reader_t* r = arg;
+    pthread_mutex_lock(&r->lock);
+    while (1) {
+        /* the chunks which need no read are skipped */
+        while (r->next_job < r->tail &&
+               r->slots[r->next_job % r->depth].state != SLOT_QUEUED) {
+            ++r->next_job;
+        }
+        if (r->stop) {
+            break;
+        }
+        if (r->next_job == r->tail) {
+            pthread_cond_wait(&r->queued, &r->lock);
+            continue;
+        }
+        slot_t* s = &r->slots[r->next_job++ % r->depth];
+        s->state = SLOT_READING;
+        pthread_mutex_unlock(&r->lock);
+        read_slot(s);
+        pthread_mutex_lock(&r->lock);
+        s->state = SLOT_DONE;
+        pthread_cond_broadcast(&r->done);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+/********************************** Reader ***********************************/
+
+/* Starts reading the next chunk in the slot of number tail. Returns 0 if
+ * there is no chunk to read yet. */
+static int start_chunk(reader_t* r) {
+    if (r->file == r->nb_files) {
+        return 0;
+    }
+    if (r->fd >= 0 && r->size < 0 && r->pending < r->tail) {
+        /* a file which can't seek is read a chunk at a time */
+        const slot_t* prev = &r->slots[r->pending % r->depth];
+        if (prev->state != SLOT_DONE) {
+            return 0;
+        }
+        if (prev->last) {
+            /* no chunk is being read from it any more */
+            close(r->fd);
+            r->fd = -1;
+            if (++r->file == r->nb_files) {
+                return 0;
+            }
+        }
+    }
+
+    const size_t i = r->tail % r->depth;
+    slot_t* s = &r->slots[i];
+    s->file = r->file;
+    s->fd = -1;
+    s->len = 0;
+    s->size = 0;
+    s->last = 1;
+    s->error = 0;
+    s->state = SLOT_DONE;
+
+    struct stat st;
+    if (r->fd < 0) {
+        r->fd = open(r->files[r->file], O_RDONLY | O_CLOEXEC);
+        if (r->fd < 0 || fstat(r->fd, &st) != 0) {
+            /* the error is returned after the chunks of the previous files,
+             * and the following files aren't read */
+            s->error = errno;
+            if (r->fd >= 0) {
+                close(r->fd);
+                r->fd = -1;
+            }
+            r->file = r->nb_files;
+            ++r->tail;
+            return 1;
+        }
+        r->size = S_ISREG(st.st_mode) ? st.st_size : -1;
+        r->offset = 0;
+        if (r->size >= 0) {
+            posix_fadvise(r->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+    }
+
+    s->fd = r->fd;
+    if (r->size < 0) {
+        /* the chunk is the last one if the end of file is reached */
+        s->offset = -1;
+        s->size = r->chunk_size;
+        s->last = 0;
+        r->pending = r->tail;
+    } else {
+        const off_t left = r->size - r->offset;
+        s->offset = r->offset;
+        s->size = left < (off_t)r->chunk_size ? (size_t)left : r->chunk_size;
+        r->offset += (off_t)s->size;
+        s->last = r->offset == r->size;
+        if (s->last) {
+            /* the descriptor is closed with the last chunk */
+            r->fd = -1;
+            ++r->file;
+        }
+    }
+    ++r->tail;
+
+    if (s->size == 0) {
+        return 1;
+    }
+    if (r->use_uring) {
+        s->state = SLOT_READING;
+        if (!uring_read(&r->uring, s, i)) {
+            s->error = errno;
+            s->state = SLOT_DONE;
+        }
+    } else {
+        s->state = SLOT_QUEUED;
+        pthread_cond_signal(&r->queued);
+    }
+    return 1;
+}
+
+/* Starts reading chunks until depth chunks are read ahead. */
+static void start_chunks(reader_t* r) {
+    if (!r->use_uring) {
+        pthread_mutex_lock(&r->lock);
+    }
+    while (r->tail - r->head < r->depth && start_chunk(r)) {
+    }
+    if (!r->use_uring) {
+        pthread_mutex_unlock(&r->lock);
+    }
+}
+
+reader_t* reader_open(char* const* files, size_t nb_files, size_t chunk_size,
+                      size_t depth, int flags) {
+    if (chunk_size == 0 || depth == 0) {
+        return NULL;
+    }
+    reader_t* r = calloc(1, sizeof(reader_t));
+    if (r == NULL) {
+        return NULL;
+    }
+    r->files = files;
+    r->nb_files = nb_files;
+    r->chunk_size = chunk_size;
+    r->depth = depth;
+    r->fd = -1;
+    r->slots = calloc(depth, sizeof(slot_t));
+    int ok = r->slots != NULL;
+    for (size_t i = 0; ok && i < depth; ++i) {
+        r->slots[i].buf = malloc(chunk_size);
+        ok = r->slots[i].buf != NULL;
+    }
+    if (!ok) {
+        reader_close(r);
+        return NULL;
+    }
+
+    r->use_uring =
+        !(flags & READER_THREADS) && uring_init(&r->uring, (unsigned)depth);
+    if (!r->use_uring) {
+        pthread_mutex_init(&r->lock, NULL);
+        pthread_cond_init(&r->queued, NULL);
+        pthread_cond_init(&r->done, NULL);
+        const size_t n =
+            depth < READER_MAX_THREADS ? depth : READER_MAX_THREADS;
+        for (; r->nb_threads < n; ++r->nb_threads) {
+            if (pthread_create(&r->threads[r->nb_threads], NULL, read_slots,
+                               r) != 0) {
+                break;
+            }
+        }
+        if (r->nb_threads == 0) {
+            reader_close(r);
+            return NULL;
+        }
+    }
+
+    start_chunks(r);
+    return r;
+}
+
+int reader_next(reader_t* r, reader_chunk_t* chunk) {
+    if (r->returned) {
+        /* recycle the buffer of the chunk returned last */
+        slot_t* s = &r->slots[r->head % r->depth];
+        if (s->last && s->offset >= 0 && s->fd >= 0) {
+            close(s->fd);
+        }
+        ++r->head;
+        r->returned = 0;
+    }
+    start_chunks(r);
+    if (r->head == r->tail) {
+        return 0;
+    }
+
+    slot_t* s = &r->slots[r->head % r->depth];
+    if (r->use_uring) {
+        while (s->state != SLOT_DONE && r->error == 0) {
+            uring_complete(r);
+        }
+    } else {
+        pthread_mutex_lock(&r->lock);
+        while (s->state != SLOT_DONE) {
+            pthread_cond_wait(&r->done, &r->lock);
+        }
+        pthread_mutex_unlock(&r->lock);
+    }
+    if (r->error == 0) {
+        r->error = s->error;
+    }
+    if (s->state != SLOT_DONE || s->error != 0) {
+        return 0;
+    }
+
+    r->returned = 1;
+    chunk->file = s->file;
+    chunk->data = s->buf;
+    chunk->size = s->len;
+    chunk->last = s->last;
+    /* read the next chunk of a file which can't seek while this one is
+     * handled */
+    start_chunks(r);
+    return 1;
+}
+
+int reader_error(const reader_t* r) { return r->error; }
+
+const char* reader_backend(const reader_t* r) {
+    return r->use_uring ? "io_uring" : "threads";
+}
+
+void reader_close(reader_t* r) {
+    if (r == NULL) {
+        return;
+    }
+    if (r->use_uring) {
+        /* the buffers are freed once the kernel no longer writes to them */
+        if (r->uring.inflight > 0) {
+            uring_enter(&r->uring, 0, (unsigned)r->uring.inflight);
+        }
+        uring_del(&r->uring);
+    } else if (r->nb_threads > 0) {
+        pthread_mutex_lock(&r->lock);
+        r->stop = 1;
+        pthread_cond_broadcast(&r->queued);
+        pthread_mutex_unlock(&r->lock);
+        for (size_t i = 0; i < r->nb_threads; ++i) {
+            pthread_join(r->threads[i], NULL);
+        }
+        pthread_mutex_destroy(&r->lock);
+        pthread_cond_destroy(&r->queued);
+        pthread_cond_destroy(&r->done);
+    }
+
+    /* close the descriptors owned by the chunks left and the next chunk */
+    for (size_t n = r->head; r->slots != NULL && n < r->tail; ++n) {
+        const slot_t* s = &r->slots[n % r->depth];
+        if (s->last && s->offset >= 0 && s->fd >= 0) {
+            close(s->fd);
+        }
+    }
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    for (size_t i = 0; r->slots != NULL && i < r->depth; ++i) {
+        free(r->slots[i].buf);
+    }
+    free(r->slots);
+    free(r);
+}
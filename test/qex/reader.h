@@ -0,0 +1,58 @@
+#ifndef QEX_READER_H_
+#define QEX_READER_H_
+
+#include <stddef.h>
+
+/*
+ * A pipelined reader of a list of files, which reads the chunks following the
+ * one being handled while it is handled, so that reading the files overlaps
+ * with parsing them. Up to depth chunks are read ahead, across the ends of the
+ * files, each in its own buffer: the buffers form a bounded queue between the
+ * reads and the caller, and a buffer is read again once its chunk is handled.
+ *
+ * The reads are submitted to the kernel through io_uring. Where io_uring is
+ * unavailable, they are done by a pool of threads instead.
+ */
+typedef struct reader reader_t;
+
+/* Forces the thread pool even if io_uring is available. */
+#define READER_THREADS 1
+
+/* A chunk of a file. */
+typedef struct reader_chunk {
+    size_t file;
+    /**< Index of the file in the list */
+    const char* data;
+    size_t size;
+    /**< Bytes read, at most the chunk size */
+    int last;
+    /**< Whether the chunk ends its file. An empty file has one empty chunk */
+} reader_chunk_t;
+
+/*
+ * Returns a reader of the nb_files files, by chunks of chunk_size bytes, with
+ * up to depth chunks read ahead. flags is 0 or READER_THREADS.
+ * NULL is returned in case of error.
+ */
+reader_t* reader_open(char* const* files, size_t nb_files, size_t chunk_size,
+                      size_t depth, int flags);
+
+/*
+ * Waits for the next chunk, in the order of the files, and sets chunk to it.
+ * The data of the chunk is valid until the next call.
+ * Returns 0 once all the files are read, or if a file can't be read.
+ */
+int reader_next(reader_t* r, reader_chunk_t* chunk);
+
+/* Returns the errno of the failure which stopped the reads, or 0 if none did.
+ * The chunks of the files before the one which failed are all returned. */
+int reader_error(const reader_t* r);
+
+/* Returns the name of the backend of the reads, "io_uring" or "threads". */
+const char* reader_backend(const reader_t* r);
+
+/* Cancels the reads in progress and deletes the reader. If NULL is given,
+ * nothing is deleted. */
+void reader_close(reader_t* r);
+
+#endif /* QEX_READER_H_ */
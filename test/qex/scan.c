@@ -0,0 +1,144 @@
+#include "scan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define QEX_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+static const char* scan_eol_scalar(const char* p, const char* end) {
+    while (p < end && *p != '\n' && *p != '\r' && *p != 0) {
+        ++p;
+    }
+    return p;
+}
+
+#ifdef QEX_SCAN_X86
+
+#define AVX2 __attribute__((target("avx2")))
+
+static int has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+
+static const char* scan_eol_sse2(const char* p, const char* end) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i nul = _mm_setzero_si128();
+    for (; end - p >= 16; p += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)p);
+        const __m128i eol =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, nl),
+                                      _mm_cmpeq_epi8(v, cr)),
+                         _mm_cmpeq_epi8(v, nul));
+        const int mask = _mm_movemask_epi8(eol);
+        if (mask != 0) {
+            return p + __builtin_ctz((unsigned)mask);
+        }
+    }
+    return scan_eol_scalar(p, end);
+}
+
+AVX2 static const char* scan_eol_avx2(const char* p, const char* end) {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i nul = _mm256_setzero_si256();
+    for (; end - p >= 32; p += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        const __m256i eol =
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, nl),
+                                            _mm256_cmpeq_epi8(v, cr)),
+                            _mm256_cmpeq_epi8(v, nul));
+        const unsigned mask = (unsigned)_mm256_movemask_epi8(eol);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return scan_eol_sse2(p, end);
+}
+
+const char* scan_eol(const char* p, const char* end) {
+    return has_avx2() ? scan_eol_avx2(p, end) : scan_eol_sse2(p, end);
+}
+
+#else
+
+const char* scan_eol(const char* p, const char* end) {
+    return scan_eol_scalar(p, end);
+}
+
+#endif /* QEX_SCAN_X86 */
+
+/* The prefix is loaded as three little-endian words: bytes 0 to 7
+ * `YYYY-MM-`, bytes 8 to 15 `DD HH:MM` and bytes 12 to 19 `HH:MM:SS\t`. For
+ * each word, DIGITS masks the bytes holding digits and SEP holds the
+ * separators in the bytes masked by SEPS. */
+#define SWAR_A_DIGITS 0x00ffff00ffffffffULL
+#define SWAR_A_SEP 0x2d00002d00000000ULL
+#define SWAR_A_SEPS 0xff0000ff00000000ULL
+#define SWAR_B_DIGITS 0xffff00ffff00ffffULL
+#define SWAR_B_SEP 0x00003a0000200000ULL
+#define SWAR_B_SEPS 0x0000ff0000ff0000ULL
+#define SWAR_C_DIGITS 0x00ffff0000000000ULL
+#define SWAR_C_SEP 0x0900003a00000000ULL
+#define SWAR_C_SEPS 0xff0000ff00000000ULL
+
+#define SWAR_ONES 0x0101010101010101ULL
+
+static uint64_t load_u64(const char* p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+/* Returns 0 if the digit bytes of w are in '0'-'9' and its separator bytes
+ * match sep, and non-zero otherwise. A byte is a digit if its high nibble is
+ * 3 and adding 6 to it doesn't carry into the high nibble. */
+static uint64_t swar_check(uint64_t w, uint64_t digits, uint64_t sep,
+                           uint64_t seps) {
+    const uint64_t high = digits & (SWAR_ONES * 0xf0);
+    const uint64_t zero = digits & (SWAR_ONES * '0');
+    return ((w ^ sep) & seps) | ((w & high) ^ zero) |
+           (((w + (digits & (SWAR_ONES * 6))) & high) ^ zero);
+}
+
+/* Returns the word whose byte i is the two-digit number made of the digits
+ * of bytes i and i + 1 of w. */
+static uint64_t swar_pairs(uint64_t w, uint64_t digits) {
+    const uint64_t x = w & digits & (SWAR_ONES * 0x0f);
+    return x * 10 + (x >> 8);
+}
+
+#define swar_byte(w, i) ((int)(((w) >> (8 * (i))) & 0xff))
+
+int scan_timestamp(const char* p, const char* end, int date[6]) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (end - p < SCAN_TIMESTAMP_LEN) {
+        return 0;
+    }
+    const uint64_t a = load_u64(p);
+    const uint64_t b = load_u64(p + 8);
+    const uint64_t c = load_u64(p + 12);
+    if ((swar_check(a, SWAR_A_DIGITS, SWAR_A_SEP, SWAR_A_SEPS) |
+         swar_check(b, SWAR_B_DIGITS, SWAR_B_SEP, SWAR_B_SEPS) |
+         swar_check(c, SWAR_C_DIGITS, SWAR_C_SEP, SWAR_C_SEPS)) != 0) {
+        return 0;
+    }
+
+    const uint64_t pa = swar_pairs(a, SWAR_A_DIGITS);
+    const uint64_t pb = swar_pairs(b, SWAR_B_DIGITS);
+    const uint64_t pc = swar_pairs(c, SWAR_C_DIGITS);
+    date[0] = swar_byte(pa, 0) * 100 + swar_byte(pa, 2);
+    date[1] = swar_byte(pa, 5);
+    date[2] = swar_byte(pb, 0);
+    date[3] = swar_byte(pb, 3);
+    date[4] = swar_byte(pb, 6);
+    date[5] = swar_byte(pc, 5);
+    return 1;
+#else
+    (void)p;
+    (void)end;
+    (void)date;
+    return 0;
+#endif
+}
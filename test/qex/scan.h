@@ -0,0 +1,22 @@
+#ifndef QEX_SCAN_H_
+#define QEX_SCAN_H_
+
+/* Length of the fixed-width `YYYY-MM-DD HH:MM:SS\t` line prefix. */
+#define SCAN_TIMESTAMP_LEN 20
+
+/*
+ * Returns a pointer on the first '\n', '\r' or NUL character of [p, end[, or
+ * end if there is none. The buffer is scanned 32 bytes at a time with AVX2, or
+ * 16 bytes at a time with SSE2.
+ */
+const char* scan_eol(const char* p, const char* end);
+
+/*
+ * Decodes the fixed-width `YYYY-MM-DD HH:MM:SS\t` prefix of [p, end[ into the
+ * year, month, day, hour, minute and second of date, without branching on the
+ * digits. Returns 0 if [p, end[ doesn't start with such a prefix, in which case
+ * date is left untouched.
+ */
+int scan_timestamp(const char* p, const char* end, int date[6]);
+
+#endif /* QEX_SCAN_H_ */
@@ -0,0 +1,318 @@
+#define _GNU_SOURCE
+#include "serve.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "delta/vec.h"
+
+/* Number of events handled per call to epoll_wait. */
+#define SERVE_MAX_EVENTS 64
+
+/* Size of the reads from the clients. */
+#define SERVE_READ_SIZE 4096
+
+typedef struct client {
+    int fd;
+    char* in;
+    /**< Bytes received and not handled yet, at most one partial line */
+    char* out;
+    size_t sent;
+    /**< Responses, of which the first sent bytes were sent */
+    uint32_t events;
+    /**< Events the client is polled for */
+    int closing;
+    /**< Whether the client is closed once its responses are sent */
+    size_t index;
+    /**< Position in the clients of the server */
+} client_t;
+
+typedef struct server {
+    int epoll;
+    serve_handler_f handler;
+    void* ctx;
+    client_t** clients;
+} server_t;
+
+/* Tags of the events which aren't from clients. */
+static char listen_tag;
+static char signal_tag;
+
+/* Closes the connection of the client and deletes it. */
+static void del_client(client_t* c) {
+    close(c->fd);
+    vec_del(c->in);
+    vec_del(c->out);
+    free(c);
+}
+
+static void close_client(server_t* s, client_t* c) {
+    const size_t last = vec_len(s->clients) - 1;
+    s->clients[c->index] = s->clients[last];
+    s->clients[c->index]->index = c->index;
+    vec_resize(&s->clients, last);
+    del_client(c);
+}
+
+static int watch(server_t* s, int op, int fd, uint32_t events, void* tag) {
+    struct epoll_event e;
+    e.events = events;
+    e.data.ptr = tag;
+    return epoll_ctl(s->epoll, op, fd, &e) == 0;
+}
+
+static void accept_clients(server_t* s, int listener) {
+    while (1) {
+        const int fd = accept4(listener, NULL, NULL,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            /* EAGAIN once all the pending connections are accepted */
+            return;
+        }
+        client_t* c = malloc(sizeof(client_t));
+        if (c == NULL) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->in = vec_make(char, 0, SERVE_READ_SIZE);
+        c->out = vec_make(char, 0, SERVE_READ_SIZE);
+        c->sent = 0;
+        c->events = EPOLLIN;
+        c->closing = 0;
+        c->index = vec_len(s->clients);
+        int ok = c->in != NULL && c->out != NULL &&
+                 watch(s, EPOLL_CTL_ADD, fd, c->events, c);
+        if (ok) {
+            vec_append(&s->clients, c);
+            ok = vec_valid(s->clients);
+        }
+        if (!ok) {
+            /* closing the socket also removes it from the epoll set */
+            del_client(c);
+        }
+    }
+}
+
+/* Appends the bytes to the responses of the client. */
+static void respond(client_t* c, const char* bytes, size_t size) {
+    const size_t len = vec_len(c->out);
+    vec_resize(&c->out, len + size);
+    if (!vec_valid(c->out)) {
+        c->closing = 1;
+        return;
+    }
+    memcpy(c->out + len, bytes, size);
+}
+
+/* Handles the complete request lines received from the client. */
+static void handle_requests(server_t* s, client_t* c) {
+    const size_t len = vec_len(c->in);
+    size_t start = 0;
+    while (!c->closing) {
+        const char* nl = memchr(c->in + start, '\n', len - start);
+        if (nl == NULL) {
+            break;
+        }
+        size_t size = (size_t)(nl - (c->in + start));
+        if (size > 0 && c->in[start + size - 1] == '\r') {
+            --size;
+        }
+
+        char* response = NULL;
+        size_t response_size = 0;
+        FILE* out = open_memstream(&response, &response_size);
+        if (out == NULL) {
+            c->closing = 1;
+            break;
+        }
+        s->handler(s->ctx, c->in + start, size, out);
+        fputc('\n', out);
+        fclose(out);
+        respond(c, response, response_size);
+        free(response);
+        start = (size_t)(nl - c->in) + 1;
+    }
+
+    memmove(c->in, c->in + start, len - start);
+    vec_resize(&c->in, len - start);
+    if (vec_len(c->in) > SERVE_MAX_REQUEST) {
+        const char error[] = "ERROR request too long\n\n";
+        respond(c, error, sizeof(error) - 1);
+        c->closing = 1;
+    }
+}
+
+/* Reads the available bytes of the client, and handles its requests.
+ * Returns 0 if the client disconnected. */
+static int read_client(server_t* s, client_t* c) {
+    while (!c->closing) {
+        const size_t len = vec_len(c->in);
+        vec_resize(&c->in, len + SERVE_READ_SIZE);
+        if (!vec_valid(c->in)) {
+            return 0;
+        }
+        const ssize_t n = read(c->fd, c->in + len, SERVE_READ_SIZE);
+        vec_resize(&c->in, len + (n > 0 ? (size_t)n : 0));
+        if (n == 0) {
+            /* answer the requests received before the end of the stream */
+            c->closing = 1;
+        } else if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        handle_requests(s, c);
+    }
+    return 1;
+}
+
+/* Sends the responses of the client, and polls it for writing if they don't
+ * all fit in the socket buffer. A closing client is no longer polled for
+ * reading.
+ * Returns 0 if the client is done or disconnected. */
+static int write_client(server_t* s, client_t* c) {
+    const size_t len = vec_len(c->out);
+    while (c->sent < len) {
+        const ssize_t n =
+            send(c->fd, c->out + c->sent, len - c->sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return 0;
+            }
+            break;
+        }
+        c->sent += (size_t)n;
+    }
+    if (c->sent == len) {
+        vec_clear(&c->out);
+        c->sent = 0;
+        if (c->closing) {
+            return 0;
+        }
+    }
+
+    const uint32_t events = (c->closing ? 0 : EPOLLIN) |
+                            (vec_len(c->out) > 0 ? EPOLLOUT : 0);
+    if (events != c->events) {
+        c->events = events;
+        return watch(s, EPOLL_CTL_MOD, c->fd, events, c);
+    }
+    return 1;
+}
+
+/* Returns a listening Unix domain socket bound to path, or -1 in case of
+ * error. */
+static int listen_at(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    /* replace the socket left by a server which didn't exit cleanly */
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int serve(const char* path, serve_handler_f handler, void* ctx) {
+    server_t s;
+    s.handler = handler;
+    s.ctx = ctx;
+    s.clients = vec_make(client_t*, 0, 16);
+    s.epoll = epoll_create1(EPOLL_CLOEXEC);
+
+    /* the signals ending the server are received as events */
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    const int sfd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    const int listener = listen_at(path);
+    int ok = s.clients != NULL && s.epoll >= 0 && sfd >= 0 && listener >= 0 &&
+             watch(&s, EPOLL_CTL_ADD, listener, EPOLLIN, &listen_tag) &&
+             watch(&s, EPOLL_CTL_ADD, sfd, EPOLLIN, &signal_tag);
+
+    struct epoll_event events[SERVE_MAX_EVENTS];
+    int running = ok;
+    while (running) {
+        const int n = epoll_wait(s.epoll, events, SERVE_MAX_EVENTS, -1);
+        if (n < 0) {
+            running = errno == EINTR;
+            ok = running;
+            continue;
+        }
+        for (int i = 0; i < n; ++i) {
+            void* tag = events[i].data.ptr;
+            if (tag == &listen_tag) {
+                accept_clients(&s, listener);
+            } else if (tag == &signal_tag) {
+                /* consume the signal, which would otherwise be delivered once
+                 * unblocked */
+                struct signalfd_siginfo info;
+                running = read(sfd, &info, sizeof(info)) != sizeof(info);
+            } else {
+                client_t* c = tag;
+                int alive = 1;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    alive = read_client(&s, c);
+                }
+                if (alive) {
+                    alive = write_client(&s, c);
+                }
+                if (!alive) {
+                    close_client(&s, c);
+                }
+            }
+        }
+    }
+
+    while (vec_len(s.clients) > 0) {
+        close_client(&s, s.clients[0]);
+    }
+    if (listener >= 0) {
+        close(listener);
+        unlink(path);
+    }
+    if (sfd >= 0) {
+        close(sfd);
+    }
+    if (s.epoll >= 0) {
+        close(s.epoll);
+    }
+    sigprocmask(SIG_UNBLOCK, &signals, NULL);
+    vec_del(s.clients);
+    return ok;
+}
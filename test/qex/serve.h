@@ -0,0 +1,30 @@
+#ifndef QEX_SERVE_H_
+#define QEX_SERVE_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Largest size of a request line, newline excluded. */
+#define SERVE_MAX_REQUEST 4096
+
+/*
+ * Handles the request held by [request, request + size[, a line without its
+ * newline, by writing the response lines to out. The server ends the response
+ * with an empty line, so the response lines must not be empty.
+ */
+typedef void (*serve_handler_f)(void* ctx, const char* request, size_t size,
+                                FILE* out);
+
+/*
+ * Listens on a Unix domain socket bound to path and answers the requests of
+ * its clients with the handler, until SIGINT or SIGTERM is received. The
+ * clients are served concurrently by an epoll event loop in the calling
+ * thread: each request is handled as soon as its line is received, and the
+ * responses are sent as the clients read them.
+ *
+ * A stale socket left at path is replaced, and the socket is removed on exit.
+ * Returns 0 in case of error.
+ */
+int serve(const char* path, serve_handler_f handler, void* ctx);
+
+#endif /* QEX_SERVE_H_ */
@@ -0,0 +1,316 @@
+#include "sketch.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "delta/heap.h"
+#include "delta/strmap.h"
+#include "delta/vec.h"
+
+/******************************** HyperLogLog ********************************/
+
+struct hll {
+    unsigned precision;
+    size_t nb_registers;
+    /* Largest rank of the hashes of each register: the position of the first
+     * bit set after the register bits. */
+    uint8_t registers[];
+};
+
+hll_t* hll_make(unsigned precision) {
+    if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION) {
+        return NULL;
+    }
+    const size_t nb_registers = (size_t)1 << precision;
+    hll_t* hll = malloc(sizeof(hll_t) + nb_registers);
+    if (hll == NULL) {
+        return NULL;
+    }
+    hll->precision = precision;
+    hll->nb_registers = nb_registers;
+    hll_clear(hll);
+    return hll;
+}
+
+void hll_del(hll_t* hll) { free(hll); }
+
+void hll_add(hll_t* hll, size_t hash) {
+    const unsigned bits = sizeof(size_t) * CHAR_BIT;
+    const size_t i = hash >> (bits - hll->precision);
+    /* the sentinel bit bounds the rank when the remaining bits are all 0 */
+    const size_t rest =
+        (hash << hll->precision) | ((size_t)1 << (hll->precision - 1));
+    const uint8_t rank =
+        (uint8_t)(__builtin_clzll((unsigned long long)rest << (64 - bits)) + 1);
+    if (rank > hll->registers[i]) {
+        hll->registers[i] = rank;
+    }
+}
+
+void hll_merge(hll_t* dst, const hll_t* src) {
+    for (size_t i = 0; i < dst->nb_registers; ++i) {
+        if (src->registers[i] > dst->registers[i]) {
+            dst->registers[i] = src->registers[i];
+        }
+    }
+}
+
+void hll_clear(hll_t* hll) { memset(hll->registers, 0, hll->nb_registers); }
+
+double hll_estimate(const hll_t* hll) {
+    const double m = (double)hll->nb_registers;
+    double sum = 0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < hll->nb_registers; ++i) {
+        sum += ldexp(1.0, -hll->registers[i]);
+        zeros += hll->registers[i] == 0;
+    }
+
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    if (hll->precision == 4) {
+        alpha = 0.673;
+    } else if (hll->precision == 5) {
+        alpha = 0.697;
+    } else if (hll->precision == 6) {
+        alpha = 0.709;
+    }
+    const double estimate = alpha * m * m / sum;
+
+    /* small cardinalities are better estimated by linear counting of the
+     * empty registers */
+    if (estimate <= 2.5 * m && zeros > 0) {
+        return m * log(m / (double)zeros);
+    }
+    return estimate;
+}
+
+double hll_error(const hll_t* hll) {
+    return 1.04 / sqrt((double)hll->nb_registers);
+}
+
+/******************************** Space-Saving *******************************/
+
+/* The min-heap of the counters holds their count and index packed in 64 bits,
+ * so that it is a heap of integers. Counts are saturated to fit. */
+#define TOPK_INDEX_BITS 24
+#define TOPK_INDEX_MASK (((uint64_t)1 << TOPK_INDEX_BITS) - 1)
+#define TOPK_COUNT_MAX (UINT64_MAX >> TOPK_INDEX_BITS)
+
+struct topk {
+    size_t nb_counters;
+    topk_counter_t* counters;
+    /* Index of the counter of each key. */
+    strmap_t index;
+    /* Counters by increasing count. The counts in the heap are updated lazily
+     * when its top is replaced: they may be lower than the counts of their
+     * counters, which only grow. */
+    uint64_t* heap;
+};
+
+static uint64_t pack_counter(const topk_t* topk, size_t i) {
+    const size_t count = topk->counters[i].count;
+    const uint64_t c = count < TOPK_COUNT_MAX ? count : TOPK_COUNT_MAX;
+    return (c << TOPK_INDEX_BITS) | i;
+}
+
+/* Sets the key of the counter to a copy of the given key. */
+static int set_key(topk_counter_t* c, const char* key, size_t key_size) {
+    char* copy = realloc(c->key, key_size + 1);
+    if (copy == NULL) {
+        return 0;
+    }
+    memcpy(copy, key, key_size);
+    copy[key_size] = 0;
+    c->key = copy;
+    c->key_size = key_size;
+    return 1;
+}
+
+topk_t* topk_make(size_t nb_counters) {
+    if (nb_counters == 0 || nb_counters > TOPK_MAX_COUNTERS) {
+        return NULL;
+    }
+    topk_t* topk = malloc(sizeof(topk_t));
+    if (topk == NULL) {
+        return NULL;
+    }
+    topk->nb_counters = nb_counters;
+    topk->counters = vec_make(topk_counter_t, 0, nb_counters);
+    topk->index = strmap_make(sizeof(size_t), nb_counters);
+    topk->heap = vec_make(uint64_t, 0, nb_counters);
+    if (topk->counters == NULL || topk->index == NULL || topk->heap == NULL) {
+        topk_del(topk);
+        return NULL;
+    }
+    return topk;
+}
+
+void topk_del(topk_t* topk) {
+    if (topk == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < vec_len(topk->counters); ++i) {
+        free(topk->counters[i].key);
+    }
+    vec_del(topk->counters);
+    strmap_del(topk->index);
+    vec_del(topk->heap);
+    free(topk);
+}
+
+int topk_add(topk_t* topk, const char* key, size_t key_size) {
+    size_t* maybe_i = strmap_at_withlen(topk->index, key, key_size);
+    if (maybe_i != NULL) {
+        ++topk->counters[*maybe_i].count;
+        return 1;
+    }
+
+    size_t i = vec_len(topk->counters);
+    if (i < topk->nb_counters) {
+        /* use a new counter */
+        topk_counter_t c = {NULL, 0, 0, 0};
+        vec_append(&topk->counters, c);
+        if (!vec_valid(topk->counters)) {
+            return 0;
+        }
+    } else {
+        /* reuse the counter of the least count, after refreshing the lazy
+         * counts at the top of the heap */
+        while (heap_peek(topk->heap) !=
+               pack_counter(topk, heap_peek(topk->heap) & TOPK_INDEX_MASK)) {
+            const size_t top = heap_peek(topk->heap) & TOPK_INDEX_MASK;
+            heap_replace_top_u64(topk->heap, pack_counter(topk, top));
+        }
+        i = heap_peek(topk->heap) & TOPK_INDEX_MASK;
+        topk_counter_t* c = &topk->counters[i];
+        strmap_erase_withlen(topk->index, c->key, c->key_size);
+        c->error = c->count;
+    }
+
+    topk_counter_t* c = &topk->counters[i];
+    if (!set_key(c, key, key_size)) {
+        return 0;
+    }
+    ++c->count;
+    topk->index = strmap_addv_withlen(topk->index, key, key_size, i);
+    if (topk->index == NULL) {
+        return 0;
+    }
+    if (vec_len(topk->heap) < vec_len(topk->counters)) {
+        heap_push_u64(&topk->heap, pack_counter(topk, i));
+        return vec_valid(topk->heap);
+    }
+    heap_replace_top_u64(topk->heap, pack_counter(topk, i));
+    return 1;
+}
+
+/* Returns the count which a key without counter may have been added, which
+ * is the least count once all the counters are used and 0 before. */
+static size_t topk_floor(const topk_t* topk) {
+    const size_t len = vec_len(topk->counters);
+    if (len < topk->nb_counters) {
+        return 0;
+    }
+    size_t least = SIZE_MAX;
+    for (size_t i = 0; i < len; ++i) {
+        if (topk->counters[i].count < least) {
+            least = topk->counters[i].count;
+        }
+    }
+    return least;
+}
+
+static int counter_cmp(const void* a, const void* b) {
+    const topk_counter_t* x = a;
+    const topk_counter_t* y = b;
+    return x->count > y->count ? -1 : x->count < y->count;
+}
+
+int topk_merge(topk_t* dst, const topk_t* src) {
+    /* a key missing from a sketch may have been added as many times as its
+     * floor, which bounds both its count and its error */
+    const size_t dst_floor = topk_floor(dst);
+    const size_t src_floor = topk_floor(src);
+    const size_t dst_len = vec_len(dst->counters);
+    const size_t src_len = vec_len(src->counters);
+
+    topk_counter_t* merged =
+        malloc((dst_len + src_len + 1) * sizeof(topk_counter_t));
+    if (merged == NULL) {
+        return 0;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < dst_len; ++i) {
+        topk_counter_t c = dst->counters[i];
+        const size_t* j = strmap_at_withlen(src->index, c.key, c.key_size);
+        c.count += j != NULL ? src->counters[*j].count : src_floor;
+        c.error += j != NULL ? src->counters[*j].error : src_floor;
+        merged[n++] = c;
+    }
+    for (size_t i = 0; i < src_len; ++i) {
+        topk_counter_t c = src->counters[i];
+        if (strmap_at_withlen(dst->index, c.key, c.key_size) == NULL) {
+            c.count += dst_floor;
+            c.error += dst_floor;
+            merged[n++] = c;
+        }
+    }
+    qsort(merged, n, sizeof(topk_counter_t), counter_cmp);
+    if (n > dst->nb_counters) {
+        n = dst->nb_counters;
+    }
+
+    /* rebuild the sketch from the counters of the highest counts */
+    topk_t* t = topk_make(dst->nb_counters);
+    int ok = t != NULL;
+    for (size_t i = 0; ok && i < n; ++i) {
+        topk_counter_t c = merged[i];
+        const char* key = c.key;
+        c.key = NULL;
+        ok = set_key(&c, key, c.key_size);
+        if (ok) {
+            vec_append(&t->counters, c);
+            t->index = strmap_addv_withlen(t->index, c.key, c.key_size, i);
+            ok = t->index != NULL;
+        }
+        if (ok) {
+            heap_push_u64(&t->heap, pack_counter(t, i));
+        }
+    }
+    free(merged);
+    if (!ok) {
+        topk_del(t);
+        return 0;
+    }
+
+    /* swap the contents of the sketches, then delete the old ones */
+    const topk_t old = *dst;
+    *dst = *t;
+    *t = old;
+    topk_del(t);
+    return 1;
+}
+
+int topk_clear(topk_t* topk) {
+    strmap_t index = strmap_make(sizeof(size_t), topk->nb_counters);
+    if (index == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < vec_len(topk->counters); ++i) {
+        free(topk->counters[i].key);
+    }
+    vec_clear(&topk->counters);
+    vec_clear(&topk->heap);
+    strmap_del(topk->index);
+    topk->index = index;
+    return 1;
+}
+
+size_t topk_len(const topk_t* topk) { return vec_len(topk->counters); }
+
+const topk_counter_t* topk_counters(const topk_t* topk) {
+    return topk->counters;
+}
@@ -0,0 +1,105 @@
+#ifndef QEX_SKETCH_H_
+#define QEX_SKETCH_H_
+
+#include <stddef.h>
+
+/*
+ * Fixed-size summaries of the queries used by `qex --approx`, whose memory use
+ * doesn't depend on the number of distinct queries. Sketches of the same size
+ * built from different inputs merge into the sketch of all of them.
+ */
+
+/*
+ * A HyperLogLog sketch estimating the number of distinct hashes added, with
+ * 2^precision one-byte registers.
+ */
+typedef struct hll hll_t;
+
+/* Smallest and largest precisions of a HyperLogLog sketch. */
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+
+/*
+ * Returns a new empty sketch of the given precision, which must be in
+ * [HLL_MIN_PRECISION, HLL_MAX_PRECISION].
+ * NULL is returned in case of error.
+ */
+hll_t* hll_make(unsigned precision);
+
+/* Deletes the sketch. If NULL is given, nothing is deleted. */
+void hll_del(hll_t* hll);
+
+/* Adds the hash of a value, which must be uniformly distributed. */
+void hll_add(hll_t* hll, size_t hash);
+
+/* Adds the hashes added to src to dst, which must have the same precision. */
+void hll_merge(hll_t* dst, const hll_t* src);
+
+/* Empties the sketch. */
+void hll_clear(hll_t* hll);
+
+/* Returns the estimated number of distinct hashes added. */
+double hll_estimate(const hll_t* hll);
+
+/*
+ * Returns the relative standard error of the estimate, 1.04 / sqrt(2^p):
+ * about 65% of the estimates are within that error of the exact count, and
+ * 95% within twice that error.
+ */
+double hll_error(const hll_t* hll);
+
+/*
+ * A Space-Saving sketch of the most frequent keys added, with a fixed number
+ * of counters. A key added more than n / counters times, where n is the number
+ * of keys added, is guaranteed to have a counter. The count of a counter never
+ * underestimates the number of times its key was added, and overestimates it
+ * by at most its error.
+ */
+typedef struct topk topk_t;
+
+/* Largest number of counters of a Space-Saving sketch. */
+#define TOPK_MAX_COUNTERS ((size_t)1 << 24)
+
+typedef struct topk_counter {
+    char* key;
+    /**< NUL-terminated copy of the key */
+    size_t key_size;
+    size_t count;
+    size_t error;
+} topk_counter_t;
+
+/*
+ * Returns a new empty sketch with the given number of counters, which must be
+ * in [1, TOPK_MAX_COUNTERS].
+ * NULL is returned in case of error.
+ */
+topk_t* topk_make(size_t counters);
+
+/* Deletes the sketch. If NULL is given, nothing is deleted. */
+void topk_del(topk_t* topk);
+
+/*
+ * Adds the key of the given size. Once all the counters are used, the key of
+ * the least count is replaced if the key has no counter.
+ * Returns 0 in case of error.
+ */
+int topk_add(topk_t* topk, const char* key, size_t key_size);
+
+/*
+ * Adds the keys added to src to dst, which must have the same number of
+ * counters: the counts of the keys of both sketches are summed, and the keys
+ * of the highest sums are kept.
+ * Returns 0 in case of error, in which case dst is left untouched.
+ */
+int topk_merge(topk_t* dst, const topk_t* src);
+
+/* Empties the sketch. Returns 0 in case of error. */
+int topk_clear(topk_t* topk);
+
+/* Returns the number of counters in use, at most the number of counters. */
+size_t topk_len(const topk_t* topk);
+
+/* Returns the counters in use, in no particular order. */
+const topk_counter_t* topk_counters(const topk_t* topk);
+
+#endif /* QEX_SKETCH_H_ */
@@ -0,0 +1,163 @@
+#include "stats.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char* phase_names[STATS_NB_PHASES] = {"read", "index", "compute",
+                                                   "output"};
+
+/* Whether the throughput of the input is printed for each phase. Only the
+ * index phase parses the lines: the read phase opens the files and waits for
+ * the reads, which overlap with the indexing or are page faults of the index
+ * phase, and the compute and output phases go through the distinct queries
+ * and the results. */
+static const bool phase_throughput[STATS_NB_PHASES] = {false, true, false,
+                                                       false};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/* Resets the peak resident memory of the process to its current one, which
+ * Linux does on writing 5 to clear_refs. Returns 0 if it can't. */
+static int reset_peak_rss(void) {
+    const int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    const int ok = write(fd, "5", 1) == 1;
+    close(fd);
+    return ok;
+}
+
+/* Returns the peak resident memory of the process in bytes, since the last
+ * reset if any. */
+static size_t peak_rss(void) {
+    char buf[4096];
+    const int fd = open("/proc/self/status", O_RDONLY);
+    if (fd >= 0) {
+        const ssize_t n = read(fd, buf, sizeof(buf) - 1);
+        close(fd);
+        buf[n > 0 ? n : 0] = 0;
+        const char* hwm = strstr(buf, "VmHWM:");
+        if (hwm != NULL) {
+            return (size_t)strtoull(hwm + 6, NULL, 10) * 1024;
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (size_t)usage.ru_maxrss * 1024;
+}
+
+void stats_init(stats_t* s) {
+    memset(s, 0, sizeof(*s));
+    s->_phase = -1;
+    for (size_t i = 0; i < STATS_NB_PHASES; ++i) {
+        s->_perf[i] = perf_make();
+    }
+}
+
+void stats_del(stats_t* s) {
+    for (size_t i = 0; i < STATS_NB_PHASES; ++i) {
+        perf_del(s->_perf[i]);
+    }
+}
+
+void stats_begin(stats_t* s, stats_phase_t phase) {
+    if (s == NULL) {
+        return;
+    }
+    stats_end(s);
+    reset_peak_rss();
+    s->_phase = (int)phase;
+    s->_start = now();
+    if (s->_perf[phase] != NULL) {
+        perf_start(s->_perf[phase]);
+    }
+}
+
+void stats_end(stats_t* s) {
+    if (s == NULL || s->_phase < 0) {
+        return;
+    }
+    if (s->_perf[s->_phase] != NULL) {
+        perf_stop(s->_perf[s->_phase]);
+    }
+    const size_t peak = peak_rss();
+    s->seconds[s->_phase] += now() - s->_start;
+    if (peak > s->peak_rss[s->_phase]) {
+        s->peak_rss[s->_phase] = peak;
+    }
+    s->_phase = -1;
+}
+
+void stats_print(const stats_t* s, FILE* out) {
+    if (s == NULL) {
+        return;
+    }
+    fprintf(out, "%-8s %10s %10s %12s %12s\n", "phase", "seconds", "MB/s",
+            "lines/s", "peak RSS MB");
+    for (size_t i = 0; i < STATS_NB_PHASES; ++i) {
+        const double t = s->seconds[i];
+        fprintf(out, "%-8s %10.3f", phase_names[i], t);
+        if (phase_throughput[i] && t > 0) {
+            fprintf(out, " %10.1f %12.0f", (double)s->bytes / 1e6 / t,
+                    (double)s->lines / t);
+        } else {
+            fprintf(out, " %10s %12s", "-", "-");
+        }
+        fprintf(out, " %12.1f\n", (double)s->peak_rss[i] / (1 << 20));
+    }
+    fprintf(out, "%-8s %10zu bytes, %zu lines\n", "input", s->bytes,
+            s->lines);
+
+    /* the events of each phase, and of each line of input */
+    perf_counts_t counts[STATS_NB_PHASES];
+    bool counted[PERF_NB_EVENTS] = {false};
+    bool any = false;
+    for (size_t i = 0; i < STATS_NB_PHASES; ++i) {
+        memset(&counts[i], 0, sizeof(counts[i]));
+        if (s->_perf[i] != NULL) {
+            counts[i] = perf_read(s->_perf[i]);
+        }
+        for (size_t e = 0; e < PERF_NB_EVENTS; ++e) {
+            counted[e] = counted[e] || counts[i].counted[e];
+            any = any || counts[i].counted[e];
+        }
+    }
+    if (!any) {
+        fprintf(out, "hardware counters are not permitted\n");
+        return;
+    }
+    fprintf(out, "%-8s", "phase");
+    for (size_t e = 0; e < PERF_NB_EVENTS; ++e) {
+        if (counted[e]) {
+            fprintf(out, " %14s", perf_event_name((perf_event_t)e));
+        }
+    }
+    fprintf(out, "\n");
+    for (size_t i = 0; i < STATS_NB_PHASES; ++i) {
+        for (int per_line = 0; per_line < 2; ++per_line) {
+            if (per_line && s->lines == 0) {
+                continue;
+            }
+            fprintf(out, "%-8s", per_line ? "  /line" : phase_names[i]);
+            for (size_t e = 0; e < PERF_NB_EVENTS; ++e) {
+                const double n = (double)counts[i].counts[e];
+                if (counted[e] && per_line) {
+                    fprintf(out, " %14.2f", n / (double)s->lines);
+                } else if (counted[e]) {
+                    fprintf(out, " %14.0f", n);
+                }
+            }
+            fprintf(out, "\n");
+        }
+    }
+}
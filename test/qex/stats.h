@@ -0,0 +1,67 @@
+#ifndef QEX_STATS_H_
+#define QEX_STATS_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "delta/perf.h"
+
+/* Phases of a run of qex, in order. */
+typedef enum stats_phase {
+    /* Opening, mapping or reading the inputs. */
+    STATS_READ,
+    /* Parsing the lines and counting their queries. */
+    STATS_INDEX,
+    /* Merging the counts and building the results. */
+    STATS_COMPUTE,
+    /* Printing or writing the results. */
+    STATS_OUTPUT,
+    STATS_NB_PHASES,
+} stats_phase_t;
+
+/*
+ * Wall time, peak resident memory and hardware events of the phases of a run.
+ * A phase may be timed several times, for instance once per file or per chunk:
+ * its times and events are summed and its peaks maxed. The peak of a phase is
+ * the one of the process while it runs where the kernel can reset it at its
+ * start, and the one of the process so far otherwise. The events are the ones
+ * of the threads created after stats_init too.
+ */
+typedef struct stats {
+    double seconds[STATS_NB_PHASES];
+    size_t peak_rss[STATS_NB_PHASES];
+    /**< Peak resident memory in bytes */
+    size_t bytes;
+    size_t lines;
+    /**< Input processed, for the throughput of the phases */
+    int _phase;
+    /**< Phase being timed, or -1 */
+    double _start;
+    perf_t* _perf[STATS_NB_PHASES];
+    /**< Hardware counters of each phase, NULL if they can't be made */
+} stats_t;
+
+void stats_init(stats_t* s);
+
+/* Deletes the counters of the stats. */
+void stats_del(stats_t* s);
+
+/*
+ * Starts timing the phase, after ending the one being timed if any. The stats
+ * functions do nothing if s is NULL, so that callers needn't check whether
+ * stats are collected.
+ */
+void stats_begin(stats_t* s, stats_phase_t phase);
+
+/* Ends the phase being timed, if any. */
+void stats_end(stats_t* s);
+
+/*
+ * Prints a table of the phases timed: their wall time, throughput in MB/s and
+ * lines/s of input, and peak resident memory, followed by a table of their
+ * hardware events if any was counted. The throughput is only printed for the
+ * index phase, which parses the lines, and is "-" for the others.
+ */
+void stats_print(const stats_t* s, FILE* out);
+
+#endif /* QEX_STATS_H_ */
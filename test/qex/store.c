@@ -0,0 +1,173 @@
+#include "store.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Identifies a store file, and its format version. */
+#define STORE_MAGIC "QEXSTOR1"
+
+typedef struct store_header {
+    char magic[8];
+    uint64_t nb_buckets;
+    uint64_t nb_postings;
+    uint64_t nb_queries;
+    uint64_t strings_size;
+} store_header_t;
+
+int store_write(const store_t* store, const char* path) {
+    store_header_t header;
+    memcpy(header.magic, STORE_MAGIC, sizeof(header.magic));
+    header.nb_buckets = store->nb_buckets;
+    header.nb_postings = store->nb_postings;
+    header.nb_queries = store->nb_queries;
+    header.strings_size = store->strings_size;
+
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) {
+        return 0;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(store->buckets, sizeof(store_bucket_t),
+                      store->nb_buckets + 1, f) == store->nb_buckets + 1;
+    ok = ok && fwrite(store->postings, sizeof(store_posting_t),
+                      store->nb_postings, f) == store->nb_postings;
+    ok = ok && fwrite(store->offsets, sizeof(uint64_t), store->nb_queries + 1,
+                      f) == store->nb_queries + 1;
+    ok = ok && fwrite(store->strings, 1, store->strings_size, f) ==
+                   store->strings_size;
+    return (fclose(f) == 0) && ok;
+}
+
+/* Returns the address of the section of n elements of the given size starting
+ * at *offset in the mapping, and moves *offset after it. NULL is returned if
+ * the section ends beyond the mapping. */
+static const void* section(const store_t* store, size_t* offset, uint64_t n,
+                           size_t size) {
+    const size_t left = store->_map_size - *offset;
+    if (n > left / size) {
+        return NULL;
+    }
+    const char* p = (const char*)store->_map + *offset;
+    *offset += (size_t)n * size;
+    return p;
+}
+
+/* Checks the sections which are read without bound checks: the buckets must be
+ * sorted, and their postings and the strings must end where the header says. */
+static int store_check(const store_t* store) {
+    for (size_t i = 0; i < store->nb_buckets; ++i) {
+        const store_bucket_t* b = &store->buckets[i];
+        if (b[0].postings > b[1].postings ||
+            (i + 1 < store->nb_buckets &&
+             store_date_cmp(b[0].date, b[1].date, 6) >= 0)) {
+            return 0;
+        }
+    }
+    return store->buckets[0].postings == 0 &&
+           store->buckets[store->nb_buckets].postings == store->nb_postings &&
+           store->offsets[store->nb_queries] == store->strings_size;
+}
+
+int store_open(store_t* store, const char* path) {
+    struct stat st;
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(store_header_t)) {
+        close(fd);
+        return 0;
+    }
+    store->_map_size = (size_t)st.st_size;
+    store->_map = mmap(NULL, store->_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (store->_map == MAP_FAILED) {
+        return 0;
+    }
+
+    const store_header_t* header = store->_map;
+    size_t offset = sizeof(store_header_t);
+    int ok = memcmp(header->magic, STORE_MAGIC, sizeof(header->magic)) == 0 &&
+             header->nb_buckets < SIZE_MAX && header->nb_queries < SIZE_MAX;
+    if (ok) {
+        store->nb_buckets = (size_t)header->nb_buckets;
+        store->nb_postings = (size_t)header->nb_postings;
+        store->nb_queries = (size_t)header->nb_queries;
+        store->strings_size = (size_t)header->strings_size;
+        store->buckets = section(store, &offset, header->nb_buckets + 1,
+                                 sizeof(store_bucket_t));
+        store->postings = section(store, &offset, header->nb_postings,
+                                  sizeof(store_posting_t));
+        store->offsets = section(store, &offset, header->nb_queries + 1,
+                                 sizeof(uint64_t));
+        store->strings =
+            section(store, &offset, header->strings_size, sizeof(char));
+        ok = store->buckets != NULL && store->postings != NULL &&
+             store->offsets != NULL && store->strings != NULL &&
+             offset == store->_map_size && store_check(store);
+    }
+    if (!ok) {
+        store_close(store);
+        return 0;
+    }
+    return 1;
+}
+
+void store_close(store_t* store) {
+    munmap(store->_map, store->_map_size);
+    store->_map = NULL;
+    store->_map_size = 0;
+}
+
+const char* store_query(const store_t* store, uint32_t id) {
+    if (id >= store->nb_queries) {
+        return NULL;
+    }
+    const uint64_t begin = store->offsets[id];
+    const uint64_t end = store->offsets[id + 1];
+    if (begin >= end || end > store->strings_size ||
+        store->strings[end - 1] != 0) {
+        return NULL;
+    }
+    return store->strings + begin;
+}
+
+int store_date_cmp(const int32_t* a, const int32_t* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+void store_find_buckets(const store_t* store, const int32_t* prefix, size_t n,
+                        size_t* first, size_t* last) {
+    /* first bucket not less than the prefix */
+    size_t lo = 0, hi = store->nb_buckets;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (store_date_cmp(store->buckets[mid].date, prefix, n) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *first = lo;
+
+    /* first bucket greater than the prefix */
+    hi = store->nb_buckets;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (store_date_cmp(store->buckets[mid].date, prefix, n) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    *last = lo;
+}
@@ -0,0 +1,84 @@
+#ifndef QEX_STORE_H_
+#define QEX_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A store is the persistent index written by `qex index` and read by
+ * `qex query`. It holds the number of times each query was done during each
+ * second, so that the queries of any range are counted without parsing the
+ * input files again.
+ *
+ * Queries are interned in a dictionary giving them dense ids. The seconds are
+ * buckets sorted by date, each one pointing to the postings of its queries: a
+ * range only reads the postings of its buckets.
+ *
+ * The file is made of a header followed by the sections below, in the native
+ * byte order, so that it is used in place once mapped in memory:
+ * - the nb_buckets + 1 buckets, the last one only ending the postings;
+ * - the nb_postings postings;
+ * - the nb_queries + 1 offsets of the queries in the strings;
+ * - the strings_size bytes of the NUL-terminated queries.
+ */
+
+/* Date of the queries of a bucket and its first posting. The date holds the
+ * year, month, day, hour, minute and second, or -1 for the missing fields. */
+typedef struct store_bucket {
+    int32_t date[6];
+    uint64_t postings;
+} store_bucket_t;
+
+/* Number of times the query of the given id was done during a bucket. */
+typedef struct store_posting {
+    uint32_t id;
+    uint32_t count;
+} store_posting_t;
+
+typedef struct store {
+    const store_bucket_t* buckets;
+    size_t nb_buckets;
+    const store_posting_t* postings;
+    size_t nb_postings;
+    const uint64_t* offsets;
+    size_t nb_queries;
+    const char* strings;
+    size_t strings_size;
+    void* _map;
+    size_t _map_size;
+} store_t;
+
+/*
+ * Writes the sections of the store to the file at path. The buckets must be
+ * sorted by date.
+ * Returns 0 in case of error.
+ */
+int store_write(const store_t* store, const char* path);
+
+/*
+ * Maps the store written in the file at path in memory.
+ * Returns 0 if it can't be read or isn't a store.
+ */
+int store_open(store_t* store, const char* path);
+
+/* Unmaps the store opened by store_open. */
+void store_close(store_t* store);
+
+/* Returns the query of the given id, or NULL if the store is corrupted. */
+const char* store_query(const store_t* store, uint32_t id);
+
+/*
+ * Compares the first n fields of two dates, -1 being less than any date field.
+ * Returns a negative, 0 or positive integer as a is less than, equal to or
+ * greater than b.
+ */
+int store_date_cmp(const int32_t* a, const int32_t* b, size_t n);
+
+/*
+ * Sets [*first, *last[ to the buckets whose n first date fields are equal to
+ * the ones of prefix, found by binary search.
+ */
+void store_find_buckets(const store_t* store, const int32_t* prefix, size_t n,
+                        size_t* first, size_t* last);
+
+#endif /* QEX_STORE_H_ */
@@ -0,0 +1,68 @@
+#undef NDEBUG
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "delta/allocator.h"
+#include "delta/segvec.h"
+
+// Allocator whose reallocations fail while fail is set. The chunks are
+// allocated, and the chunk directory reallocated when it grows.
+static bool fail = false;
+
+static void* test_allocate(void* ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void test_deallocate(void* ctx, void* ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+static void* test_reallocate(void* ctx, void* ptr, size_t old_size,
+                             size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return fail ? NULL : realloc(ptr, new_size);
+}
+
+static const allocator_t test_allocator = {NULL, test_allocate,
+                                           test_deallocate, test_reallocate,
+                                           NULL};
+
+// A segvec whose chunk directory fails to grow can be appended to once memory
+// is available again.
+static void test_append_after_failure(void) {
+    segvec_config_t config = segvec_config(sizeof(int));
+    config.first_chunk_len = 1;
+    config.max_chunk_len = 1;
+    config.allocator = &test_allocator;
+    segvec_t sv = segvec_make_from_config(&config);
+    assert(sv != NULL);
+
+    // a chunk per element, so that the directory grows with the elements
+    int n = 0;
+    for (; n < 64; ++n) {
+        assert(segvec_append(sv, &n) != NULL);
+    }
+    fail = true;
+    for (; segvec_append(sv, &n) != NULL; ++n) {
+    }
+    assert(segvec_len(sv) == (size_t)n);
+    fail = false;
+    for (int i = 0; i < 64; ++i, ++n) {
+        assert(segvec_append(sv, &n) != NULL);
+    }
+
+    assert(segvec_len(sv) == (size_t)n);
+    for (int i = 0; i < n; ++i) {
+        assert(*(int*)segvec_at(sv, (size_t)i) == i);
+    }
+    segvec_del(sv);
+}
+
+int main(void) {
+    test_append_after_failure();
+    return 0;
+}
@@ -0,0 +1,56 @@
+#undef NDEBUG
+#include <assert.h>
+#include <stdlib.h>
+
+#include "delta/allocator.h"
+#include "delta/strmap.h"
+
+// Size of the values, large enough that the values of a bucket are the only
+// allocations of their size.
+#define VALUE_SIZE 1000
+
+// Number of values in a bucket, as in src/strmap.c.
+#define BUCKET_CAPACITY 8
+
+// Counts the allocations of the values of the buckets.
+static void* counting_allocate(void* ctx, size_t size) {
+    if (size == VALUE_SIZE * BUCKET_CAPACITY) {
+        ++*(size_t*)ctx;
+    }
+    return malloc(size);
+}
+
+static void counting_deallocate(void* ctx, void* ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+// Returns the number of values a map of the given capacity is made with.
+static size_t slots(size_t capacity) {
+    size_t nb_buckets = 0;
+    const allocator_t allocator = {&nb_buckets, counting_allocate,
+                                   counting_deallocate, NULL, NULL};
+    strmap_config_t config = strmap_config(VALUE_SIZE, capacity);
+    config.allocator = &allocator;
+    strmap_t m = strmap_make_from_config(&config);
+    assert(m != NULL);
+    strmap_del(m);
+    return nb_buckets * BUCKET_CAPACITY;
+}
+
+// The capacity of a map is rounded up to the next power of 2.
+static void test_capacity(void) {
+    assert(slots(0) == 8);
+    assert(slots(8) == 8);
+    assert(slots(9) == 16);
+    assert(slots(13) == 16);
+    assert(slots(15) == 16);
+    assert(slots(16) == 16);
+    assert(slots(17) == 32);
+    assert(slots(1000) == 1024);
+}
+
+int main(void) {
+    test_capacity();
+    return 0;
+}
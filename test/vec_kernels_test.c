@@ -0,0 +1,76 @@
+#undef NDEBUG
+#include <assert.h>
+#include <stdint.h>
+
+#include "delta/vec.h"
+#include "delta/vec_kernels.h"
+
+// The kernels agree with plain loops on every length up to a few vectors,
+// whose tails go through the scalar kernels, and the first calls resolve the
+// implementation of each kernel.
+static void test_kernels(void) {
+    for (size_t len = 0; len < 100; ++len) {
+        uint8_t* v8 = vec_make(uint8_t, len, len);
+        uint32_t* v32 = vec_make(uint32_t, len, len);
+        uint64_t* v64 = vec_make(uint64_t, len, len);
+        double* vf = vec_make(double, len, len);
+        assert(v8 != NULL && v32 != NULL && v64 != NULL && vf != NULL);
+        uint32_t x = (uint32_t)len;
+        uint64_t sum8 = 0, sum32 = 0, sum64 = 0;
+        size_t count = 0;
+        for (size_t i = 0; i < len; ++i) {
+            x = x * 1664525 + 1013904223;
+            v8[i] = (uint8_t)(x >> 29);
+            v32[i] = (uint32_t)v8[i] << 28;
+            v64[i] = (uint64_t)v8[i] << 60;
+            vf[i] = v8[i];
+            sum8 += v8[i];
+            sum32 += v32[i];
+            sum64 += v64[i];
+            count += v8[i] == 3;
+        }
+
+        size_t first = SIZE_MAX;
+        for (size_t i = len; i-- > 0;) {
+            first = v8[i] == 3 ? i : first;
+        }
+        assert(vec_find_u8(v8, 3) == first);
+        assert(vec_find_u32(v32, (uint32_t)3 << 28) == first);
+        assert(vec_find_u64(v64, (uint64_t)3 << 60) == first);
+        assert(vec_count_eq_u8(v8, 3) == count);
+        assert(vec_count_eq_u32(v32, (uint32_t)3 << 28) == count);
+        assert(vec_count_eq_u64(v64, (uint64_t)3 << 60) == count);
+        assert(vec_sum_u8(v8) == sum8);
+        assert(vec_sum_u32(v32) == sum32);
+        assert(vec_sum_u64(v64) == sum64);
+        assert(vec_sum_f64(vf) == (double)sum8);
+
+        uint8_t min8 = 0, max8 = 0;
+        uint32_t min32 = 0, max32 = 0;
+        uint64_t min64 = 0, max64 = 0;
+        double minf = 0, maxf = 0;
+        assert(vec_minmax_u8(v8, &min8, &max8) == (len > 0));
+        assert(vec_minmax_u32(v32, &min32, &max32) == (len > 0));
+        assert(vec_minmax_u64(v64, &min64, &max64) == (len > 0));
+        assert(vec_minmax_f64(vf, &minf, &maxf) == (len > 0));
+        for (size_t i = 0; i < len; ++i) {
+            assert(min8 <= v8[i] && v8[i] <= max8);
+            assert(min32 <= v32[i] && v32[i] <= max32);
+            assert(min64 <= v64[i] && v64[i] <= max64);
+            assert(minf <= vf[i] && vf[i] <= maxf);
+        }
+        assert(len == 0 || (vec_find_u8(v8, min8) != SIZE_MAX &&
+                            vec_find_u8(v8, max8) != SIZE_MAX));
+        assert(len == 0 || (uint32_t)min8 << 28 == min32);
+        assert(len == 0 || (uint64_t)min8 << 60 == min64);
+        vec_del(v8);
+        vec_del(v32);
+        vec_del(v64);
+        vec_del(vf);
+    }
+}
+
+int main(void) {
+    test_kernels();
+    return 0;
+}